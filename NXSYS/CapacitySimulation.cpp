@@ -0,0 +1,218 @@
+//
+//  CapacitySimulation.cpp
+//  NXSYS
+//
+//  The whole interlocking runs on virtual time (see timers.h), so relay timers,
+//  switch movement, automatic stops and the train stepper all mature in order
+//  with no waiting; only the CPU limits how fast simulated hours pass.
+//
+
+#include "windows.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "xtgtrack.h"
+#include "signal.h"
+#include "traindcl.h"
+#include "trainaut.h"
+#include "trainapi.h"
+#include "commands.h"
+#include "timers.h"
+#include "usermsg.h"
+#include "CapacitySimulation.hpp"
+
+bool CapacitySimulating = false;
+
+static const long CapacityTickMS = 100;   // granularity of train entry
+static const long DelayBucketSecs = 30;
+static const int  DelayBuckets = 20;      // last one is "and over"
+
+struct EntryState {
+    CapacityEntry Spec;
+    TrackUnit * Track;
+    DWORD NextDue;
+    int Entered;
+    int Failed;        // trains due that could not be created
+    DWORD HeldMS;      // trains kept waiting by an occupied entry section
+};
+
+struct RunningTrain {
+    long EntryIJ;
+};
+
+struct TripRecord {
+    DWORD When;
+    int TrainNo;
+    long EntryIJ;
+    std::string SignalName;
+};
+
+static std::map<int, RunningTrain> Running;
+static std::map<std::pair<long, std::string>, int> RouteCounts;
+static std::map<Signal*, DWORD> StandingMS;
+static std::vector<int> DelayHistogram;
+static std::vector<TripRecord> Trips;
+static DWORD SimStart;
+
+void CapacityNoteStanding (Signal * g, long ms) {
+    StandingMS[g] += (DWORD)ms;
+}
+
+void CapacityNoteTrainGone (int train_no, const char * last_ij, double lost_ms, Signal * tripped_at) {
+    auto it = Running.find(train_no);
+    if (it == Running.end())
+        return;
+    long entry = it->second.EntryIJ;
+    Running.erase(it);
+
+    int bucket = (int)(lost_ms / 1000.0 / DelayBucketSecs);
+    if (bucket < 0)
+        bucket = 0;
+    if (bucket >= DelayBuckets)
+        bucket = DelayBuckets - 1;
+    DelayHistogram[bucket]++;
+
+    if (tripped_at)
+        Trips.push_back({NXTimerNow() - SimStart, train_no, entry, tripped_at->CompactName()});
+    else
+        RouteCounts[{entry, last_ij}]++;
+}
+
+static int FreeTrainNumber () {
+    int train_no = 1;
+    while (TrainAutoValidateTrainNo(train_no))
+        train_no++;
+    return train_no;
+}
+
+static std::string HMS (DWORD ms) {
+    DWORD secs = ms / 1000;
+    char buf[32];
+    snprintf (buf, sizeof(buf), "%lu:%02lu:%02lu", (unsigned long)(secs / 3600),
+              (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+    return buf;
+}
+
+static bool WriteReport (const char * path, double hours,
+                         const std::vector<EntryState>& entries, size_t still_running) {
+    FILE * f = fopen (path, "w");
+    if (f == NULL)
+        return false;
+
+    int entered = 0, failed = 0, completed = 0;
+    for (auto& e : entries) {
+        entered += e.Entered;
+        failed += e.Failed;
+    }
+    for (auto& rc : RouteCounts)
+        completed += rc.second;
+
+    fprintf (f, "Capacity simulation, %.2f hours\n", hours);
+    fprintf (f, "Trains entered %d, ran through %d, tripped %d, still running at end %zu\n",
+             entered, completed, (int)Trips.size(), still_running);
+    if (failed)
+        fprintf (f, "Trains due but not created %d (demand is under-counted)\n", failed);
+    fprintf (f, "\n");
+
+    fprintf (f, "Entry        Headway  Entered  Failed  Held (total)\n");
+    for (auto& e : entries)
+        fprintf (f, "%-10ld %7lds %8d %7d  %s\n", e.Spec.IJ, e.Spec.HeadwaySecs,
+                 e.Entered, e.Failed, HMS(e.HeldMS).c_str());
+
+    fprintf (f, "\nRoute (entry -> last joint)         Trains  Per hour\n");
+    for (auto& rc : RouteCounts)
+        fprintf (f, "%-10ld -> %-20s %8d  %8.1f\n", rc.first.first, rc.first.second.c_str(),
+                 rc.second, rc.second / hours);
+
+    fprintf (f, "\nTime lost to signals per train, against running at cruising speed\n");
+    for (int i = 0; i < DelayBuckets; i++) {
+        if (DelayHistogram[i] == 0)
+            continue;
+        if (i == DelayBuckets - 1)
+            fprintf (f, "  %4lds and over  %6d\n", i * DelayBucketSecs, DelayHistogram[i]);
+        else
+            fprintf (f, "  %4ld-%4lds      %6d\n", i * DelayBucketSecs,
+                     (i + 1) * DelayBucketSecs, DelayHistogram[i]);
+    }
+
+    fprintf (f, "\nTime trains stood at signals\n");
+    std::vector<std::pair<std::string, DWORD>> standing;
+    for (auto& s : StandingMS)
+        standing.emplace_back(s.first->CompactName(), s.second);
+    std::sort(standing.begin(), standing.end(),
+              [](const std::pair<std::string, DWORD>& a, const std::pair<std::string, DWORD>& b) {
+                  return a.second > b.second;
+              });
+    for (auto& s : standing)
+        fprintf (f, "  %-12s %s\n", s.first.c_str(), HMS(s.second).c_str());
+
+    fprintf (f, "\nTrip-stop events\n");
+    for (auto& t : Trips)
+        fprintf (f, "  %s  train %d from %ld tripped at %s\n", HMS(t.When).c_str(),
+                 t.TrainNo, t.EntryIJ, t.SignalName.c_str());
+    fclose (f);
+    return true;
+}
+
+bool RunCapacitySimulation (double hours, const std::vector<CapacityEntry>& specs,
+                            const char * report_path) {
+    std::vector<EntryState> entries;
+    for (auto& spec : specs) {
+        TrackUnit * tk = FindTrainEntryTrackSectionByNomenclature (spec.IJ);
+        if (tk == NULL) {
+            usermsgstop ("Invalid capacity simulation entry, track end IJ #%ld", spec.IJ);
+            return false;
+        }
+        entries.push_back({spec, tk, 0, 0, 0, 0});
+    }
+
+    TrainMiscCtl (CmKillTrains);
+    Running.clear();
+    RouteCounts.clear();
+    StandingMS.clear();
+    Trips.clear();
+    DelayHistogram.assign(DelayBuckets, 0);
+
+    SetVirtualTime (true);
+    CapacitySimulating = true;
+    SimStart = NXTimerNow();
+    DWORD duration = (DWORD)(hours * 3600.0 * 1000.0);
+    for (auto& e : entries)
+        e.NextDue = SimStart;
+
+    for (DWORD now = SimStart; now - SimStart < duration; now = NXTimerNow()) {
+        for (auto& e : entries) {
+            if ((int)(now - e.NextDue) < 0)
+                continue;
+            if (e.Track->TrainCount) {	/* previous train not clear yet */
+                e.HeldMS += CapacityTickMS;
+                continue;
+            }
+            int train_no = FreeTrainNumber();
+            e.NextDue = now + (DWORD)e.Spec.HeadwaySecs * 1000;
+            if (!TrainAutoCreate (train_no, e.Spec.IJ, TRAIN_CTL_HEADLESS)) {
+                e.Failed++;     /* counted in the report; the next is due as usual */
+                continue;
+            }
+            Running[train_no] = {e.Spec.IJ};
+            e.Entered++;
+        }
+        AdvanceVirtualTime (CapacityTickMS);
+    }
+
+    size_t still_running = Running.size();
+    TrainMiscCtl (CmKillTrains);
+    CapacitySimulating = false;
+    SetVirtualTime (false);
+    Running.clear();
+
+    if (!WriteReport (report_path, hours, entries, still_running)) {
+        usermsgstop ("Cannot write capacity simulation report %s", report_path);
+        return false;
+    }
+    return true;
+}
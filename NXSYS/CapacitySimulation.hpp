@@ -0,0 +1,30 @@
+//
+//  CapacitySimulation.hpp
+//  NXSYS
+//
+//  Headless train-capacity simulation: trains enter at end-of-track sections
+//  on a fixed headway, without dialogs, under virtual time, for as many
+//  simulated hours as asked, and a throughput/delay report is written.
+//
+
+#ifndef CapacitySimulation_hpp
+#define CapacitySimulation_hpp
+
+#include <vector>
+
+class Signal;
+
+struct CapacityEntry {
+    long IJ;            // end-of-track joint, as in TRAIN CREATE
+    long HeadwaySecs;
+};
+
+bool RunCapacitySimulation (double hours, const std::vector<CapacityEntry>& entries,
+                            const char * report_path);
+
+/* Called by the train system while a simulation is running. */
+extern bool CapacitySimulating;
+void CapacityNoteStanding (Signal * g, long ms);
+void CapacityNoteTrainGone (int train_no, const char * last_ij, double lost_ms, Signal * tripped_at);
+
+#endif /* CapacitySimulation_hpp */
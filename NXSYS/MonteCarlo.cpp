@@ -0,0 +1,238 @@
+//
+//  MonteCarlo.cpp
+//  NXSYS
+//
+//  The interlocking is loaded and compiled once; every scenario starts from a
+//  snapshot of it (Snapshot.hpp), with no trains, taken at the outset, and
+//  runs on virtual time as the capacity simulation does.  A relay race
+//  abandons its scenario, which the next restore cleans up after.
+//
+
+#include "windows.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+
+#include "xtgtrack.h"
+#include "signal.h"
+#include "traindcl.h"
+#include "trainaut.h"
+#include "trainapi.h"
+#include "commands.h"
+#include "timers.h"
+#include "rlytrapi.h"
+#include "usermsg.h"
+#include "STLExtensions.h"
+#include "Snapshot.hpp"
+#include "MonteCarlo.hpp"
+
+bool MonteCarloRunning = false;
+
+static const long MonteCarloTickMS = 500;
+static const double TrainEverySecs = 90.0;   // mean, per entry
+static const double RouteEverySecs = 15.0;   // mean, whole panel
+static const double CancelEverySecs = 120.0;
+static const double MinSpeedFraction = 0.3;  // of cruising, at entry
+
+struct RelayRaceError {
+    std::string Message;
+};
+
+struct Entry {
+    long IJ;
+    TrackUnit * Track;
+};
+
+struct Failure {
+    long Seed;
+    DWORD When;
+    std::string What;
+};
+
+static long Seed;
+static DWORD ScenarioStart;
+static std::map<int, long> EntryOf;      // running train -> entry joint
+static std::vector<Failure> Races;
+static std::vector<Failure> Trips;
+
+void MonteCarloNoteTrip (int train_no, Signal * tripped_at) {
+    auto it = EntryOf.find(train_no);
+    long entry = (it == EntryOf.end()) ? 0 : it->second;
+    Trips.push_back({Seed, NXTimerNow() - ScenarioStart,
+                     FormatString("train %d from %ld tripped at %s", train_no, entry,
+                                  tripped_at->CompactName().c_str())});
+}
+
+static void RaceThrower (const char * message) {
+    throw RelayRaceError{message};
+}
+
+static int CollectObject (GraphicObject * g, void * v) {
+    ((std::vector<GraphicObject*> *)v)->push_back(g);
+    return 0;
+}
+
+static int FreeTrainNumber () {
+    int train_no = 1;
+    while (TrainAutoValidateTrainNo(train_no))
+        train_no++;
+    return train_no;
+}
+
+static std::string HMS (DWORD ms) {
+    DWORD secs = ms / 1000;
+    char buf[32];
+    snprintf (buf, sizeof(buf), "%lu:%02lu:%02lu", (unsigned long)(secs / 3600),
+              (unsigned long)(secs / 60 % 60), (unsigned long)(secs % 60));
+    return buf;
+}
+
+class Scenario {
+public:
+    Scenario (long seed, const std::vector<Entry>& entries,
+              const std::vector<GraphicObject*>& signals,
+              const std::vector<GraphicObject*>& exits) :
+        TrainsEntered(0), RoutesRequested(0),
+        Rng((std::mt19937::result_type)seed), Entries(entries), Signals(signals), Exits(exits) {}
+
+    void Run (DWORD duration);
+
+    int TrainsEntered;
+    int RoutesRequested;
+
+private:
+    std::mt19937 Rng;
+    const std::vector<Entry>& Entries;
+    const std::vector<GraphicObject*>& Signals;
+    const std::vector<GraphicObject*>& Exits;
+
+    bool Chance (double every_secs) {
+        return std::uniform_real_distribution<double>(0.0, every_secs)(Rng)
+            < MonteCarloTickMS / 1000.0;
+    }
+    GraphicObject * Pick (const std::vector<GraphicObject*>& v) {
+        return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(Rng)];
+    }
+    void EnterTrain (size_t i);
+    void RequestRoute ();
+};
+
+void Scenario::EnterTrain (size_t i) {
+    if (Entries[i].Track->TrainCount)
+        return;
+    int train_no = FreeTrainNumber();
+    if (!TrainAutoCreate (train_no, Entries[i].IJ, TRAIN_CTL_HEADLESS))
+        return;
+    EntryOf[train_no] = Entries[i].IJ;
+    double fraction = std::uniform_real_distribution<double>(MinSpeedFraction, 1.0)(Rng);
+    TrainAutoSetSpeed (train_no, fraction * TrainAutoGetSpeed(train_no));
+    TrainsEntered++;
+}
+
+/* As a signalman would: press an entrance, then one of the exits it lights. */
+void Scenario::RequestRoute () {
+    Pick(Signals)->Hit(WM_LBUTTONDOWN);
+    NXGOMouseUp();
+    std::vector<GraphicObject*> lit;
+    for (GraphicObject * g : Exits)
+        if (((ExitLight*)g)->Lit)
+            lit.push_back(g);
+    if (lit.empty())
+        return;
+    Pick(lit)->Hit(WM_LBUTTONDOWN);
+    RoutesRequested++;
+}
+
+void Scenario::Run (DWORD duration) {
+    for (DWORD now = ScenarioStart; now - ScenarioStart < duration; now = NXTimerNow()) {
+        for (size_t i = 0; i < Entries.size(); i++)
+            if (Chance(TrainEverySecs))
+                EnterTrain(i);
+        if (!Signals.empty() && !Exits.empty() && Chance(RouteEverySecs))
+            RequestRoute();
+        if (!Signals.empty() && Chance(CancelEverySecs)) {
+            Pick(Signals)->Hit(WM_LBUTTONDOWN);   /* cancels if selected */
+            NXGOMouseUp();
+        }
+        AdvanceVirtualTime (MonteCarloTickMS);
+    }
+}
+
+static bool WriteReport (const char * path, const MonteCarloSpec& spec,
+                         int entered, int routes) {
+    FILE * f = fopen (path, "w");
+    if (f == NULL)
+        return false;
+
+    fprintf (f, "Monte Carlo run, %ld scenarios of %.1f minutes, seeds %ld-%ld\n",
+             spec.Scenarios, spec.Minutes, spec.FirstSeed, spec.FirstSeed + spec.Scenarios - 1);
+    fprintf (f, "Trains entered %d, routes requested %d, relay races %d, trips %d\n",
+             entered, routes, (int)Races.size(), (int)Trips.size());
+    fprintf (f, "Replay a scenario by running one, with its seed as the first.\n");
+
+    fprintf (f, "\nRelay races\n");
+    for (auto& r : Races)
+        fprintf (f, "  seed %-8ld %s  %s\n", r.Seed, HMS(r.When).c_str(), r.What.c_str());
+    fprintf (f, "\nTrip-stop events\n");
+    for (auto& t : Trips)
+        fprintf (f, "  seed %-8ld %s  %s\n", t.Seed, HMS(t.When).c_str(), t.What.c_str());
+    fclose (f);
+    return true;
+}
+
+bool RunMonteCarlo (const MonteCarloSpec& spec, const char * report_path) {
+    std::vector<Entry> entries;
+    for (long ij : spec.EntryIJs) {
+        TrackUnit * tk = FindTrainEntryTrackSectionByNomenclature (ij);
+        if (tk == NULL) {
+            usermsgstop ("Invalid Monte Carlo entry, track end IJ #%ld", ij);
+            return false;
+        }
+        entries.push_back({ij, tk});
+    }
+    std::vector<GraphicObject*> signals, exits;
+    MapFindGraphicObjectsOfType (TypeId::SIGNAL, CollectObject, &signals);
+    MapFindGraphicObjectsOfType (TypeId::EXITLIGHT, CollectObject, &exits);
+
+    TrainMiscCtl (CmKillTrains);
+    Races.clear();
+    Trips.clear();
+    SetVirtualTime (true);
+    Snapshot base;
+    TakeSnapshot (base);
+
+    SetRelayRaceHandler (RaceThrower);
+    MonteCarloRunning = true;
+    DWORD duration = (DWORD)(spec.Minutes * 60.0 * 1000.0);
+    int entered = 0, routes = 0;
+    for (long i = 0; i < spec.Scenarios; i++) {
+        Seed = spec.FirstSeed + i;
+        if (!RestoreSnapshot (base))
+            break;
+        EntryOf.clear();
+        ScenarioStart = NXTimerNow();
+        Scenario scenario (Seed, entries, signals, exits);
+        try {
+            scenario.Run (duration);
+        }
+        catch (RelayRaceError& e) {
+            Races.push_back({Seed, NXTimerNow() - ScenarioStart, e.Message});
+        }
+        entered += scenario.TrainsEntered;
+        routes += scenario.RoutesRequested;
+    }
+    MonteCarloRunning = false;
+    SetRelayRaceHandler (NULL);
+    RestoreSnapshot (base);
+    TrainMiscCtl (CmKillTrains);
+    SetVirtualTime (false);
+    EntryOf.clear();
+
+    if (!WriteReport (report_path, spec, entered, routes)) {
+        usermsgstop ("Cannot write Monte Carlo report %s", report_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+//
+//  MonteCarlo.hpp
+//  NXSYS
+//
+//  Randomized safety regression over the loaded interlocking: many short
+//  scenarios of random route requests, signal cancels and train entries at
+//  random speeds, each from the same starting state and each reproducible
+//  from its seed.  Relay races and automatic-stop trips are reported with
+//  the seed that produced them.
+//
+
+#ifndef MonteCarlo_hpp
+#define MonteCarlo_hpp
+
+#include <vector>
+
+class Signal;
+
+struct MonteCarloSpec {
+    long Scenarios;
+    long FirstSeed;             // scenario i runs on seed FirstSeed + i
+    double Minutes;             // simulated, per scenario
+    std::vector<long> EntryIJs; // end-of-track joints, as in TRAIN CREATE
+};
+
+bool RunMonteCarlo (const MonteCarloSpec& spec, const char * report_path);
+
+/* Called by the train system while scenarios are running. */
+extern bool MonteCarloRunning;
+void MonteCarloNoteTrip (int train_no, Signal * tripped_at);
+
+#endif /* MonteCarlo_hpp */
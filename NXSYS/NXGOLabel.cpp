@@ -50,8 +50,8 @@ void NXGOLabel::SetText (const char * lab) {
 
 
 void NXGOLabel::Display (HDC hDC) {
-    /* at < .8 resolution, don't draw */
-    if (NXGO_GetDisplayScale() >= 0.8)
+    /* too small to read, don't draw */
+    if (NXGO_TextLegible (wp_limits.bottom - wp_limits.top))
         DrawText (hDC, s, (int)strlen(s), &sc_limits, DT_TOP | DT_LEFT |DT_SINGLELINE | DT_NOCLIP);
 }
 
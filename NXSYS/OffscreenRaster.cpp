@@ -0,0 +1,374 @@
+//
+//  OffscreenRaster.cpp
+//  NXSYS
+//
+//  Fills are by scanline, sampled at pixel centers, so that abutting shapes
+//  neither overlap nor leave seams; polygons are filled alternate (even-odd),
+//  as GDI's are by default.  Lines wider than a pixel are a filled rectangle
+//  along the segment with round ends, as GDI's default pen draws them.
+//
+//  PNG is written with a compressor of its own: one deflate block of the
+//  fixed codes, matching only against the pixel to the left and the pixel
+//  above, which is where all the repetition in a panel is.  A mostly black
+//  panel comes out at about a hundredth of its raw size.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "OffscreenRaster.hpp"
+
+/* The printable ASCII characters, 5 columns each, low bit at top; row 7 is
+   for descenders. */
+static const unsigned char Glyphs[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00},
+    {0x14,0x7F,0x14,0x7F,0x14}, {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62},
+    {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00}, {0x00,0x1C,0x22,0x41,0x00},
+    {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00},
+    {0x20,0x10,0x08,0x04,0x02}, {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00},
+    {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33}, {0x18,0x14,0x12,0x7F,0x10},
+    {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},
+    {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00},
+    {0x00,0x40,0x34,0x00,0x00}, {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14},
+    {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06}, {0x3E,0x41,0x5D,0x59,0x4E},
+    {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01},
+    {0x3E,0x41,0x41,0x51,0x73}, {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00},
+    {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, {0x7F,0x40,0x40,0x40,0x40},
+    {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46},
+    {0x26,0x49,0x49,0x49,0x32}, {0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F},
+    {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, {0x63,0x14,0x08,0x14,0x63},
+    {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04},
+    {0x40,0x40,0x40,0x40,0x40}, {0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40},
+    {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28}, {0x38,0x44,0x44,0x28,0x7F},
+    {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78},
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00},
+    {0x7F,0x10,0x28,0x44,0x00}, {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78},
+    {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, {0xFC,0x18,0x24,0x24,0x18},
+    {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24},
+    {0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C},
+    {0x3C,0x40,0x30,0x40,0x3C}, {0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C},
+    {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, {0x00,0x00,0x77,0x00,0x00},
+    {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02}
+};
+static const int GlyphCellWidth = 6;
+static const int GlyphCellHeight = 8;
+
+OffscreenRaster::OffscreenRaster (int width, int height) :
+    Width_(std::max(width, 1)), Height_(std::max(height, 1)),
+    RGBA((size_t)Width_ * Height_ * 4, 0) {
+    Clear (0);
+}
+
+OffscreenRaster::Color OffscreenRaster::Pixel (int x, int y) const {
+    if (x < 0 || y < 0 || x >= Width_ || y >= Height_)
+        return 0;
+    const unsigned char * p = &RGBA[((size_t)y * Width_ + x) * 4];
+    return ((Color)p[0] << 16) | ((Color)p[1] << 8) | p[2];
+}
+
+void OffscreenRaster::SetPixel (int x, int y, Color c) {
+    if (x < 0 || y < 0 || x >= Width_ || y >= Height_)
+        return;
+    unsigned char * p = &RGBA[((size_t)y * Width_ + x) * 4];
+    p[0] = (c >> 16) & 0xFF;
+    p[1] = (c >> 8) & 0xFF;
+    p[2] = c & 0xFF;
+    p[3] = 0xFF;
+}
+
+void OffscreenRaster::Span (int y, int x0, int x1, Color c) {
+    if (y < 0 || y >= Height_)
+        return;
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, Width_);
+    for (int x = x0; x < x1; x++)
+        SetPixel (x, y, c);
+}
+
+void OffscreenRaster::Clear (Color c) {
+    for (int y = 0; y < Height_; y++)
+        Span (y, 0, Width_, c);
+}
+
+void OffscreenRaster::FillRect (int left, int top, int right, int bottom, Color c) {
+    for (int y = std::max(top, 0); y < std::min(bottom, Height_); y++)
+        Span (y, left, right, c);
+}
+
+static int PixelAt (double x) {     /* first pixel whose center is at or past x */
+    return (int)ceil(x - 0.5);
+}
+
+void OffscreenRaster::FillEllipse (int left, int top, int right, int bottom, Color c) {
+    double cx = (left + right) / 2.0, cy = (top + bottom) / 2.0;
+    double rx = (right - left) / 2.0, ry = (bottom - top) / 2.0;
+    if (rx <= 0 || ry <= 0)
+        return;
+    for (int y = std::max(top, 0); y < std::min(bottom, Height_); y++) {
+        double dy = (y + 0.5 - cy) / ry;
+        if (dy * dy >= 1.0)
+            continue;
+        double hw = rx * sqrt(1.0 - dy * dy);
+        Span (y, PixelAt(cx - hw), PixelAt(cx + hw), c);
+    }
+}
+
+void OffscreenRaster::FillPolygon (const double * xs, const double * ys, int n, Color c) {
+    if (n < 3)
+        return;
+    double ymin = ys[0], ymax = ys[0];
+    for (int i = 1; i < n; i++) {
+        ymin = std::min(ymin, ys[i]);
+        ymax = std::max(ymax, ys[i]);
+    }
+    std::vector<double> crossings;
+    for (int y = std::max(PixelAt(ymin), 0); y < std::min(PixelAt(ymax), Height_); y++) {
+        double sy = y + 0.5;
+        crossings.clear();
+        for (int i = 0, j = n - 1; i < n; j = i++)
+            if ((ys[i] <= sy) != (ys[j] <= sy))
+                crossings.push_back(xs[j] + (sy - ys[j]) * (xs[i] - xs[j]) / (ys[i] - ys[j]));
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+            Span (y, PixelAt(crossings[k]), PixelAt(crossings[k + 1]), c);
+    }
+}
+
+void OffscreenRaster::FillPolygon (const Point * points, int n, Color c) {
+    std::vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; i++) {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+    FillPolygon (xs.data(), ys.data(), n, c);
+}
+
+/* A pen of one pixel or none draws as GDI's does, every pixel but the last. */
+void OffscreenRaster::Line (int x0, int y0, int x1, int y1, int width, Color c) {
+    if (width <= 1) {
+        int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy;
+        while (x0 != x1 || y0 != y1) {
+            SetPixel (x0, y0, c);
+            int e2 = 2 * err;
+            if (e2 >= dy) {
+                err += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx) {
+                err += dx;
+                y0 += sy;
+            }
+        }
+        return;
+    }
+    double h = width / 2.0;
+    double len = hypot(x1 - x0, y1 - y0);
+    if (len > 0) {
+        double nx = -(y1 - y0) / len * h, ny = (x1 - x0) / len * h;
+        double xs[4] = {x0 + nx, x1 + nx, x1 - nx, x0 - nx};
+        double ys[4] = {y0 + ny, y1 + ny, y1 - ny, y0 - ny};
+        FillPolygon (xs, ys, 4, c);
+    }
+    int r = width / 2;
+    FillEllipse (x0 - r, y0 - r, x0 - r + width, y0 - r + width, c);
+    FillEllipse (x1 - r, y1 - r, x1 - r + width, y1 - r + width, c);
+}
+
+static int GlyphScale (int height) {
+    return std::max(1, (height + GlyphCellHeight / 2) / GlyphCellHeight);
+}
+
+void OffscreenRaster::TextExtent (const char * s, int height, int& width, int& cell_height) {
+    int scale = GlyphScale(height);
+    width = (int)strlen(s) * GlyphCellWidth * scale;
+    cell_height = GlyphCellHeight * scale;
+}
+
+void OffscreenRaster::Text (int x, int y, const char * s, int height, Color c) {
+    int scale = GlyphScale(height);
+    for (; *s; s++, x += GlyphCellWidth * scale) {
+        unsigned char ch = (unsigned char)*s;
+        const unsigned char * g = Glyphs[(ch >= 32 && ch < 127) ? ch - 32 : '?' - 32];
+        for (int col = 0; col < 5; col++)
+            for (int row = 0; row < GlyphCellHeight; row++)
+                if (g[col] & (1 << row))
+                    FillRect (x + col * scale, y + row * scale,
+                              x + (col + 1) * scale, y + (row + 1) * scale, c);
+    }
+}
+
+
+/* PNG */
+
+class DeflateBits {
+public:
+    DeflateBits (std::vector<unsigned char>& out) : Out(out) {}
+    void Put (uint32_t v, int n) {
+        Bits |= v << Count;
+        Count += n;
+        while (Count >= 8) {
+            Out.push_back((unsigned char)Bits);
+            Bits >>= 8;
+            Count -= 8;
+        }
+    }
+    void PutCode (uint32_t code, int n) {    /* Huffman codes go high bit first */
+        uint32_t r = 0;
+        for (int i = 0; i < n; i++)
+            r |= ((code >> i) & 1) << (n - 1 - i);
+        Put (r, n);
+    }
+    void Literal (int v) {
+        if (v < 144)
+            PutCode (0x30 + v, 8);
+        else if (v < 256)
+            PutCode (0x190 + v - 144, 9);
+        else if (v < 280)
+            PutCode (v - 256, 7);
+        else
+            PutCode (0xC0 + v - 280, 8);
+    }
+    void Match (int length, int distance);
+    void Flush () {
+        if (Count > 0)
+            Out.push_back((unsigned char)Bits);
+        Bits = 0;
+        Count = 0;
+    }
+private:
+    std::vector<unsigned char>& Out;
+    uint32_t Bits = 0;
+    int Count = 0;
+};
+
+static const int LengthBase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,
+                                   35,43,51,59,67,83,99,115,131,163,195,227,258};
+static const int LengthExtra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,
+                                    3,3,3,3,4,4,4,4,5,5,5,5,0};
+static const int DistanceBase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,
+                                     513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+static const int DistanceExtra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,
+                                      8,8,9,9,10,10,11,11,12,12,13,13};
+static const int MaxMatch = 258;
+static const int MaxDistance = 32768;
+
+void DeflateBits::Match (int length, int distance) {
+    int l = 28;
+    while (LengthBase[l] > length)
+        l--;
+    Literal (257 + l);
+    Put (length - LengthBase[l], LengthExtra[l]);
+    int d = 29;
+    while (DistanceBase[d] > distance)
+        d--;
+    PutCode (d, 5);
+    Put (distance - DistanceBase[d], DistanceExtra[d]);
+}
+
+static void Deflate (const std::vector<unsigned char>& in, int row_bytes, std::vector<unsigned char>& out) {
+    out.push_back(0x78);        /* zlib: deflate, 32K window */
+    out.push_back(0x01);
+    DeflateBits bits(out);
+    bits.Put (1, 1);            /* the last block */
+    bits.Put (1, 2);            /* of the fixed codes */
+    const int distances[2] = {4, row_bytes};
+    size_t n = in.size();
+    for (size_t p = 0; p < n; ) {
+        int best = 0, best_distance = 0;
+        for (int d : distances) {
+            if (d > MaxDistance || (size_t)d > p)
+                continue;
+            int len = 0;
+            while (len < MaxMatch && p + len < n && in[p + len] == in[p + len - d])
+                len++;
+            if (len > best) {
+                best = len;
+                best_distance = d;
+            }
+        }
+        if (best >= 3) {
+            bits.Match (best, best_distance);
+            p += best;
+        }
+        else
+            bits.Literal (in[p++]);
+    }
+    bits.Literal (256);
+    bits.Flush();
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : in) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((unsigned char)(adler >> shift));
+}
+
+static uint32_t CRC32 (const unsigned char * p, size_t n, uint32_t crc = 0) {
+    static uint32_t table[256];
+    if (table[1] == 0)
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    crc = ~crc;
+    while (n--)
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutBig32 (std::vector<unsigned char>& v, uint32_t x) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        v.push_back((unsigned char)(x >> shift));
+}
+
+static bool WriteChunk (FILE * f, const char * type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    PutBig32 (chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    PutBig32 (chunk, CRC32(chunk.data() + 4, chunk.size() - 4));
+    return fwrite (chunk.data(), 1, chunk.size(), f) == chunk.size();
+}
+
+bool OffscreenRaster::WritePNG (const char * path) const {
+    std::vector<unsigned char> header;
+    PutBig32 (header, (uint32_t)Width_);
+    PutBig32 (header, (uint32_t)Height_);
+    header.push_back(8);        /* bits per channel */
+    header.push_back(6);        /* RGBA */
+    header.push_back(0);        /* deflate */
+    header.push_back(0);        /* adaptive filtering, of which none is used */
+    header.push_back(0);        /* not interlaced */
+
+    size_t row_bytes = (size_t)Width_ * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * Height_);
+    for (int y = 0; y < Height_; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), RGBA.begin() + y * row_bytes, RGBA.begin() + (y + 1) * row_bytes);
+    }
+    std::vector<unsigned char> compressed;
+    Deflate (raw, (int)(row_bytes + 1), compressed);
+
+    FILE * f = fopen (path, "wb");
+    if (f == NULL)
+        return false;
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    bool ok = fwrite (signature, 1, sizeof(signature), f) == sizeof(signature)
+        && WriteChunk (f, "IHDR", header)
+        && WriteChunk (f, "IDAT", compressed)
+        && WriteChunk (f, "IEND", std::vector<unsigned char>());
+    return (fclose (f) == 0) && ok;
+}
@@ -0,0 +1,58 @@
+//
+//  OffscreenRaster.hpp
+//  NXSYS
+//
+//  An in-memory RGBA image, and the few drawing operations the panel's
+//  objects make through GDI -- lines with a pen of some width, filled
+//  rectangles, polygons and ellipses, and text -- done in software, with
+//  no window system at all, and written out as PNG.  Coordinates are
+//  pixels, origin top left; everything is clipped to the image.
+//
+//  Text is in a built-in 5x7 font, scaled up by whole pixels to about the
+//  height asked, so images are the same wherever they are made, if not as
+//  pretty as the screen.
+//
+
+#ifndef OffscreenRaster_hpp
+#define OffscreenRaster_hpp
+
+#include <cstdint>
+#include <vector>
+
+class OffscreenRaster {
+public:
+    typedef uint32_t Color;         /* 0xRRGGBB */
+
+    struct Point {
+        int x, y;
+    };
+
+    OffscreenRaster (int width, int height);
+
+    int Width () const {return Width_;}
+    int Height () const {return Height_;}
+    Color Pixel (int x, int y) const;
+    void SetPixel (int x, int y, Color c);
+
+    void Clear (Color c);
+    void FillRect (int left, int top, int right, int bottom, Color c);
+    void FillEllipse (int left, int top, int right, int bottom, Color c);
+    void FillPolygon (const Point * points, int n, Color c);
+    void Line (int x0, int y0, int x1, int y1, int width, Color c);
+
+    /* Text of about height pixels, top left at x, y; the extent is that of
+       the cell, as GDI's is. */
+    void Text (int x, int y, const char * s, int height, Color c);
+    static void TextExtent (const char * s, int height, int& width, int& cell_height);
+
+    bool WritePNG (const char * path) const;
+
+private:
+    int Width_, Height_;
+    std::vector<unsigned char> RGBA;
+
+    void Span (int y, int x0, int x1, Color c);     /* x0 through x1 - 1 */
+    void FillPolygon (const double * xs, const double * ys, int n, Color c);
+};
+
+#endif /* OffscreenRaster_hpp */
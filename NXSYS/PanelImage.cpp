@@ -0,0 +1,83 @@
+//
+//  PanelImage.cpp
+//  NXSYS
+//
+//  On the Mac, the panel draws through the GDI shim (DeviceContext.mm) into
+//  an OffscreenRaster, as it would into the view.  On Windows, GDI itself
+//  draws into a bitmap in memory, which is copied out to be written; the
+//  raster's own drawing is for where there is no GDI at all.
+//
+
+#include "windows.h"
+#include <string.h>
+#include "nxgo.h"
+#include "OffscreenRaster.hpp"
+#include "PanelImage.hpp"
+
+extern HFONT Fnt;
+
+static const long MaxImagePixels = 1L << 28;
+
+#ifdef NXSYSMac
+HDC GetOffscreenDC_(OffscreenRaster * raster);
+
+static void DrawPanel (OffscreenRaster& raster, const WPRECT& view, double scale) {
+    HDC dc = GetOffscreenDC_(&raster);
+    SetTextColor(dc, RGB(255, 255, 255));
+    SetBkMode(dc, TRANSPARENT);
+    NXGO_DisplayLayout(dc, view, scale);
+    ReleaseDC(NULL, dc);
+}
+#else
+static void DrawPanel (OffscreenRaster& raster, const WPRECT& view, double scale) {
+    int width = raster.Width(), height = raster.Height();
+    HDC screen = GetDC(NULL);
+    HDC dc = CreateCompatibleDC(screen);
+    ReleaseDC(NULL, screen);
+    BITMAPINFO bmi;
+    memset(&bmi, 0, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;       /* top row first */
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void * bits = NULL;
+    HBITMAP bitmap = CreateDIBSection(dc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (bitmap == NULL) {
+        DeleteDC(dc);
+        return;
+    }
+    HGDIOBJ old_bitmap = SelectObject(dc, bitmap);
+    RECT all = {0, 0, width, height};
+    FillRect(dc, &all, (HBRUSH)GetStockObject(BLACK_BRUSH));
+    SelectObject(dc, Fnt);
+    SetBkColor(dc, RGB(0, 0, 0));
+    SetTextColor(dc, RGB(255, 255, 255));
+    NXGO_DisplayLayout(dc, view, scale);
+    GdiFlush();
+    const unsigned char * p = (const unsigned char *)bits;
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++, p += 4)
+            raster.SetPixel(x, y, ((OffscreenRaster::Color)p[2] << 16) | (p[1] << 8) | p[0]);
+    SelectObject(dc, old_bitmap);
+    DeleteObject(bitmap);
+    DeleteDC(dc);
+}
+#endif
+
+bool WritePanelImage (const char * path, double scale) {
+    RECT extent = NXGO_ComputeTrueLayoutDimensions();
+    WPRECT view;
+    view.left = extent.left;
+    view.top = extent.top;
+    view.right = extent.right;
+    view.bottom = extent.bottom;
+    long width = (long)((view.right - view.left) * scale) + 1;
+    long height = (long)((view.bottom - view.top) * scale) + 1;
+    if (scale <= 0.0 || (double)width * height > MaxImagePixels)
+        return false;
+    OffscreenRaster raster ((int)width, (int)height);
+    DrawPanel (raster, view, scale);
+    return raster.WritePNG (path);
+}
@@ -0,0 +1,16 @@
+//
+//  PanelImage.hpp
+//  NXSYS
+//
+//  A picture of the whole panel as it now stands -- track, signals, lights,
+//  switches, labels -- written to a PNG file, drawn off the screen at any
+//  scale whatever the window is showing, for record and for comparing runs
+//  image by image.
+//
+
+#ifndef PanelImage_hpp
+#define PanelImage_hpp
+
+bool WritePanelImage (const char * path, double scale);
+
+#endif /* PanelImage_hpp */
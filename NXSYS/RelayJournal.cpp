@@ -0,0 +1,313 @@
+//
+//  RelayJournal.cpp
+//  NXSYS
+//
+//  The file is a magic number and version followed by records, each a tag
+//  byte, the time since the previous record as a varint, and then:
+//
+//      event       relay id, varint
+//      define      name length, varint, and name; takes the next relay id
+//      checkpoint  relay count, varint, and their states, 8 to a byte
+//      gap         nothing; events were lost before this
+//
+//  The tag's low 3 bits are the RelayEvent, or one of the Tag values below,
+//  and its 0x08 bit the state.  Most records are three or four bytes.  Relays
+//  are defined as the journal starts, and named nowhere else.
+//
+
+#include "windows.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "relays.h"
+#include "rlytrapi.h"
+#include "timers.h"
+#include "MapperThunker.h"
+#include "RelayJournal.hpp"
+
+static const uint32_t JournalMagic = 0x4E58524A;      // "NXRJ"
+static const uint32_t JournalVersion = 1;
+static const uint32_t CheckpointEveryMS = 60 * 1000;
+
+static const int TagDefine = 5;
+static const int TagCheckpoint = 6;
+static const int TagGap = 7;
+static const int TagKindMask = 0x07;
+static const int TagState = 0x08;
+
+bool RelayJournalOpen = false;
+
+static FILE * Journal = NULL;
+static uint32_t OpenedAt;
+static uint32_t LastTime;            /* journal time of the last record */
+static uint32_t LastCheckpoint;
+static std::vector<Relay*> JournalRelays;
+static std::unordered_map<Relay*, uint32_t> JournalIds;
+
+static void PutVarint (uint64_t v) {
+    while (v >= 0x80) {
+        putc ((int)(v & 0x7F) | 0x80, Journal);
+        v >>= 7;
+    }
+    putc ((int)v, Journal);
+}
+
+/* Time never runs backwards in the journal, even if virtual time is
+   turned off under it. */
+static void PutTag (int tag, uint32_t now) {
+    uint32_t t = now - OpenedAt;
+    if ((int32_t)(t - LastTime) < 0)
+        t = LastTime;
+    putc (tag, Journal);
+    PutVarint (t - LastTime);
+    LastTime = t;
+}
+
+static uint32_t DefineRelay (Relay * r, uint32_t now) {
+    uint32_t id = (uint32_t)JournalRelays.size();
+    JournalRelays.push_back(r);
+    JournalIds[r] = id;
+    std::string name = r->RelaySym.u.r->PRep();
+    PutTag (TagDefine, now);
+    PutVarint (name.size());
+    fwrite (name.data(), 1, name.size(), Journal);
+    return id;
+}
+
+static void PutCheckpoint (uint32_t now) {
+    PutTag (TagCheckpoint, now);
+    PutVarint (JournalRelays.size());
+    for (size_t i = 0; i < JournalRelays.size(); i += 8) {
+        int bits = 0;
+        for (size_t j = 0; j < 8 && i + j < JournalRelays.size(); j++)
+            if (JournalRelays[i + j]->State)
+                bits |= 1 << j;
+        putc (bits, Journal);
+    }
+    LastCheckpoint = LastTime;
+    fflush (Journal);
+}
+
+bool StartRelayJournal (const char * path) {
+    StopRelayJournal();
+    Journal = fopen (path, "wb");
+    if (Journal == NULL)
+        return false;
+    fwrite (&JournalMagic, sizeof(JournalMagic), 1, Journal);
+    fwrite (&JournalVersion, sizeof(JournalVersion), 1, Journal);
+    OpenedAt = NXTimerNow();
+    LastTime = 0;
+
+    std::vector<Relay*> relays;
+    auto pusher = [&](Rlysym * rsp, void*) {
+        if (rsp->rly)
+            relays.push_back(rsp->rly);
+    };
+    map_relay_syms(single_arg_thunker<Rlysym*>(pusher), &pusher);
+    std::sort(relays.begin(), relays.end(), [](Relay* a, Relay* b) {return *a < *b;});
+    for (Relay * r : relays)
+        DefineRelay (r, OpenedAt);
+    PutCheckpoint (OpenedAt);
+
+    RelayJournalOpen = true;
+    SetRelayJournaling (true);
+    return true;
+}
+
+void StopRelayJournal () {
+    if (Journal == NULL)
+        return;
+    SetRelayJournaling (false);
+    RelayJournalOpen = false;
+    PutCheckpoint (NXTimerNow());
+    fclose (Journal);
+    Journal = NULL;
+    JournalRelays.clear();
+    JournalIds.clear();
+}
+
+void JournalRelayEvent (Relay * r, RelayEvent kind, int state, uint32_t time) {
+    auto it = JournalIds.find(r);
+    uint32_t id = (it != JournalIds.end()) ? it->second : DefineRelay (r, time);
+    PutTag ((int)kind | (state ? TagState : 0), time);
+    PutVarint (id);
+}
+
+void JournalGap (uint32_t time) {
+    PutTag (TagGap, time);
+}
+
+void JournalQuiescent (uint32_t time) {
+    if (time - OpenedAt - LastCheckpoint >= CheckpointEveryMS)
+        PutCheckpoint (time);
+}
+
+
+/* Reading back.  The whole journal is decoded into memory once; after that
+   every question is a binary search. */
+
+class JournalReader {
+public:
+    JournalReader (const std::vector<unsigned char>& b) : P(b.data()), End(b.data() + b.size()) {}
+    bool More () const {return P < End;}
+    int Byte () {return (P < End) ? *P++ : (Bad = true, 0);}
+    uint64_t Varint () {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int b = Byte();
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+        }
+        return v;
+    }
+    bool Bad = false;
+private:
+    const unsigned char * P, * End;
+};
+
+bool RelayJournal::Load (const char * path) {
+    FILE * f = fopen (path, "rb");
+    if (f == NULL)
+        return false;
+    std::vector<unsigned char> blob;
+    unsigned char buf[65536];
+    for (size_t n; (n = fread (buf, 1, sizeof(buf), f)) > 0; )
+        blob.insert(blob.end(), buf, buf + n);
+    fclose (f);
+
+    uint32_t magic, version;
+    if (blob.size() < sizeof(magic) + sizeof(version))
+        return false;
+    memcpy (&magic, blob.data(), sizeof(magic));
+    memcpy (&version, blob.data() + sizeof(magic), sizeof(version));
+    if (magic != JournalMagic || version != JournalVersion)
+        return false;
+    blob.erase(blob.begin(), blob.begin() + sizeof(magic) + sizeof(version));
+
+    Names.clear(); Ids.clear(); Events.clear(); ByRelay.clear();
+    Checkpoints_.clear(); Gaps.clear();
+    JournalReader r(blob);
+    uint32_t time = 0;
+    /* A record cut off by a crash ends the journal where it starts. */
+    while (r.More() && !r.Bad) {
+        int tag = r.Byte();
+        time += (uint32_t)r.Varint();
+        switch (tag & TagKindMask) {
+            case TagDefine: {
+                std::string name;
+                for (uint64_t n = r.Varint(); n > 0 && !r.Bad; n--)
+                    name += (char)r.Byte();
+                if (r.Bad)
+                    break;
+                Ids[name] = (uint32_t)Names.size();
+                Names.push_back(name);
+                ByRelay.emplace_back();
+                break;
+            }
+            case TagCheckpoint: {
+                uint64_t n = r.Varint();
+                if (n > Names.size())
+                    r.Bad = true;
+                if (r.Bad)
+                    break;
+                Checkpoint cp {time, Events.size(), std::vector<char>((size_t)n)};
+                for (size_t i = 0; i < cp.States.size(); i += 8) {
+                    int bits = r.Byte();
+                    for (size_t j = 0; j < 8 && i + j < cp.States.size(); j++)
+                        cp.States[i + j] = (bits >> j) & 1;
+                }
+                if (!r.Bad)
+                    Checkpoints_.push_back(std::move(cp));
+                break;
+            }
+            case TagGap:
+                Gaps.push_back(Gap{time, Events.size(), Checkpoints_.size()});
+                break;
+            default: {
+                uint32_t id = (uint32_t)r.Varint();
+                if (r.Bad || id >= Names.size())
+                    break;
+                Event e {time, id, (RelayEvent)(tag & TagKindMask), (char)((tag & TagState) != 0)};
+                if (e.Kind == RelayEvent::Transition)
+                    ByRelay[id].push_back(Events.size());
+                Events.push_back(e);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool RelayJournal::FindRelay (const std::string& name, uint32_t& id) const {
+    auto it = Ids.find(name);
+    if (it == Ids.end())
+        return false;
+    id = it->second;
+    return true;
+}
+
+/* The last thing known of the relay by then is either its last transition
+   or the last checkpoint, whichever is later in the journal -- unless
+   events were lost since.  A gap and a checkpoint between the same two
+   events are told apart by the checkpoints before the gap. */
+int RelayJournal::StateAt (uint32_t id, uint32_t time) const {
+    if (id >= ByRelay.size())
+        return -1;
+    const std::vector<size_t>& mine = ByRelay[id];
+    auto t = std::upper_bound(mine.begin(), mine.end(), time,
+                              [this](uint32_t tm, size_t e) {return tm < Events[e].Time;});
+    size_t known_at = 0;
+    size_t checkpoints = 0;                 /* before what is known */
+    int state = -1;
+    if (t != mine.begin()) {
+        known_at = *(t - 1) + 1;
+        state = Events[*(t - 1)].State;
+    }
+    auto c = std::upper_bound(Checkpoints_.begin(), Checkpoints_.end(), time,
+                              [](uint32_t tm, const Checkpoint& cp) {return tm < cp.Time;});
+    if (c != Checkpoints_.begin()) {
+        --c;
+        if (c->FirstEvent >= known_at && id < c->States.size()) {
+            known_at = c->FirstEvent;
+            checkpoints = (c - Checkpoints_.begin()) + 1;
+            state = c->States[id];
+        }
+    }
+    if (state < 0)
+        return -1;
+    auto g = std::lower_bound(Gaps.begin(), Gaps.end(), Gap{0, known_at, checkpoints},
+                              [](const Gap& a, const Gap& b) {
+                                  return a.Event < b.Event
+                                      || (a.Event == b.Event && a.Checkpoints < b.Checkpoints);
+                              });
+    if (g != Gaps.end() && g->Time <= time)
+        return -1;
+    return state;
+}
+
+std::vector<RelayJournal::Event> RelayJournal::Transitions (uint32_t id, uint32_t from, uint32_t to) const {
+    std::vector<Event> result;
+    if (id >= ByRelay.size())
+        return result;
+    const std::vector<size_t>& mine = ByRelay[id];
+    auto t = std::lower_bound(mine.begin(), mine.end(), from,
+                              [this](size_t e, uint32_t tm) {return Events[e].Time < tm;});
+    for (; t != mine.end() && Events[*t].Time <= to; ++t)
+        result.push_back(Events[*t]);
+    return result;
+}
+
+void RelayJournal::Replay (size_t n, uint32_t until,
+                           std::function<void(const Event&, const std::vector<char>&)> fn) const {
+    if (n >= Checkpoints_.size())
+        return;
+    std::vector<char> states (Checkpoints_[n].States);
+    states.resize(Names.size(), 0);
+    for (size_t i = Checkpoints_[n].FirstEvent; i < Events.size() && Events[i].Time <= until; i++) {
+        const Event& e = Events[i];
+        if (e.Kind == RelayEvent::Transition)
+            states[e.Relay] = e.State;
+        fn (e, states);
+    }
+}
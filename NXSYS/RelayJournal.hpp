@@ -0,0 +1,82 @@
+//
+//  RelayJournal.hpp
+//  NXSYS
+//
+//  An append-only file of everything the relay system does while it is open:
+//  every transition, every external change (report, toggle, pulse, timer
+//  firing), and, once a simulated minute, a checkpoint of every relay's
+//  state.  Journal times are milliseconds of NXTimerNow() since the journal
+//  was started.  A journal is of one load; loading another interlocking
+//  closes it.
+//
+//  RelayJournal reads one back and indexes it by time and by relay, so
+//  that the state of a relay at a time, its transitions over an interval,
+//  and the whole panel from any checkpoint on, come without re-running.
+//
+
+#ifndef RelayJournal_hpp
+#define RelayJournal_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+class Relay;
+
+enum class RelayEvent : char {Transition, Report, Toggle, Pulse, TimerFired};
+
+bool StartRelayJournal (const char * path);
+void StopRelayJournal ();
+
+/* Called by the relay system, from its trace ring (relays.cpp). */
+extern bool RelayJournalOpen;
+void JournalRelayEvent (Relay * r, RelayEvent kind, int state, uint32_t time);
+void JournalGap (uint32_t time);            /* the ring overran the journal */
+void JournalQuiescent (uint32_t time);      /* at rest: checkpoint if due */
+
+class RelayJournal {
+public:
+    struct Event {
+        uint32_t Time;
+        uint32_t Relay;
+        RelayEvent Kind;
+        char State;
+    };
+    struct Checkpoint {
+        uint32_t Time;
+        size_t FirstEvent;                  /* the events after it */
+        std::vector<char> States;           /* by relay id */
+    };
+
+    bool Load (const char * path);          /* false if not a journal */
+
+    size_t Relays () const {return Names.size();}
+    const std::string& Name (uint32_t id) const {return Names[id];}
+    bool FindRelay (const std::string& name, uint32_t& id) const;
+
+    int StateAt (uint32_t id, uint32_t time) const;     /* -1 if unknown */
+    std::vector<Event> Transitions (uint32_t id, uint32_t from, uint32_t to) const;
+
+    const std::vector<Checkpoint>& Checkpoints () const {return Checkpoints_;}
+    /* Every event from checkpoint n through time until, with the states of
+       all relays as of just after it. */
+    void Replay (size_t n, uint32_t until,
+                 std::function<void(const Event&, const std::vector<char>&)> fn) const;
+
+private:
+    std::vector<std::string> Names;
+    std::unordered_map<std::string, uint32_t> Ids;
+    std::vector<Event> Events;                  /* in time order */
+    std::vector<std::vector<size_t>> ByRelay;   /* transitions, into Events */
+    std::vector<Checkpoint> Checkpoints_;
+    struct Gap {
+        uint32_t Time;
+        size_t Event;                           /* the events after it */
+        size_t Checkpoints;                     /* and those before it */
+    };
+    std::vector<Gap> Gaps;                      /* in journal order */
+};
+
+#endif /* RelayJournal_hpp */
@@ -0,0 +1,166 @@
+//
+//  RelayPlot.cpp
+//  NXSYS
+//
+//  As PrintInterlocking (NXSYSWindows/nxsldrly.cpp) and the print code do,
+//  with the pages in an SVGPlot.  Every circuit is laid out first, in
+//  parallel (LayOutCircuits); placing and drawing them is then quick.  The
+//  drafter's page is borrowed, and left empty at its old size after.
+//
+
+#include "windows.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include "lisp.h"
+#include "relays.h"
+#include "ldraw.h"
+#include "RLYINDEX.H"
+#include "compat32.h"
+#include "usermsg.h"
+#include "MapperThunker.h"
+#include "SVGPlot.hpp"
+#include "RelayPlot.hpp"
+
+static const int PlotPageWidth = 1100;      /* 11 x 8.5 in, at 100 to the inch */
+static const int PlotPageHeight = 850;
+
+static SVGPlot * Plot = NULL;
+static HFONT TextFont, TitleFont;
+static int BotLoc;
+static std::string Footer;
+
+/* As print.cpp's FramePage, when the page is begun. */
+static void BeginPage () {
+    Plot->NewPage();
+    SelectObject (Plot, TitleFont);
+    MoveTo (Plot, 0, 0);
+    LineTo (Plot, PlotPageWidth-1, 0);
+    LineTo (Plot, PlotPageWidth-1, PlotPageHeight-1);
+    LineTo (Plot, 0, PlotPageHeight-1);
+    LineTo (Plot, 0, 0);
+
+    std::string s = Footer + "    Page " + std::to_string(Plot->Pages()) + "  ";
+    RECT tr;
+    tr.top = tr.bottom = tr.left = tr.right = 0;
+    DrawText (Plot, s.c_str(), (int)s.size(), &tr, DT_TOP|DT_LEFT|DT_SINGLELINE|DT_CALCRECT);
+    tr.top = BotLoc - tr.bottom - 3;
+    tr.bottom = BotLoc - 3;
+    tr.left = 0;
+    tr.right = PlotPageWidth - 3;
+    DrawText (Plot, s.c_str(), (int)s.size(), &tr, DT_TOP|DT_RIGHT|DT_SINGLELINE);
+    SelectObject (Plot, TextFont);
+}
+
+static void FinishPage () {
+    RecordIndexDrawnRelays (Plot->Pages());
+    RenderRelayPage (Plot);
+    ClearRelayGraphics();
+}
+
+static int IndexMoreProc () {
+    BeginPage();
+    return 1;
+}
+
+static bool RelayOrder (const RelayCircuit& a, const RelayCircuit& b) {
+    Rlysym * ar = a.relay->RelaySym.u.r;
+    Rlysym * br = b.relay->RelaySym.u.r;
+    if (ar->n != br->n)
+        return ar->n < br->n;
+    return strcmp (redeemRlsymId (ar->type), redeemRlsymId (br->type)) < 0;
+}
+
+/* Every relay with expr code, but timers' controls, which are drawn as the
+   timers. */
+static std::vector<RelayCircuit> CollectCircuits () {
+    std::vector<RelayCircuit> circuits;
+    std::set<Relay*> controls;
+    auto collect = [&](Rlysym * rs, void*) {
+        Relay * r = rs->rly;
+        if (r == NULL || r->exp == NULL || (r->Flags & LF_CCExp))
+            return;
+        if (r->Flags & LF_Timer) {
+            Relay * control = ZAppendRlysym(r->RelaySym).u.r->rly;
+            controls.insert(control);
+            circuits.push_back({r, control->exp, 1});
+        }
+        else
+            circuits.push_back({r, r->exp, 0});
+    };
+    map_relay_syms(single_arg_thunker<Rlysym*>(collect), &collect);
+    circuits.erase(std::remove_if(circuits.begin(), circuits.end(),
+                                  [&](const RelayCircuit& c) {return controls.count(c.relay) != 0;}),
+                   circuits.end());
+    std::sort(circuits.begin(), circuits.end(), RelayOrder);
+    return circuits;
+}
+
+bool PlotInterlocking (const char * path, const char * title) {
+    std::vector<RelayCircuit> circuits = CollectCircuits();
+    if (circuits.empty()) {
+        usermsgstop ("No expr-code relays loaded at this interlocking.  "
+                     "Run the appropriate .trk file.");
+        return false;
+    }
+
+    time_t now = time(NULL);
+    char datime[32];
+    strftime (datime, sizeof(datime), "%a %b %d %H:%M:%S %Y", localtime (&now));
+    Footer = std::string(title) + "    " + datime;
+
+    int width, height, canonm, flags;
+    DrawingGetPageSize (width, height, canonm, flags);
+    CleanUpDrawing();
+
+    int minm = PlotPageHeight;
+    LOGFONT lf;
+    memset (&lf, 0, sizeof(LOGFONT));
+    lf.lfHeight = minm/70;
+    strcpy (lf.lfFaceName, "Helvetica");
+    TextFont = CreateFontIndirect (&lf);
+    int text_height = lf.lfHeight;
+    lf.lfHeight = minm/40;
+    TitleFont = CreateFontIndirect (&lf);
+    BotLoc = PlotPageHeight - lf.lfHeight/5;
+
+    SVGPlot plot (PlotPageWidth, PlotPageHeight, text_height);
+    Plot = &plot;
+    plot.DefineFont (TextFont, text_height);
+    plot.DefineFont (TitleFont, lf.lfHeight);
+    for (auto& c : circuits)
+        plot.Linkable (c.relay->RelaySym.u.r->PRep());
+    DrawingSetPageSize (PlotPageWidth, BotLoc, minm, LDRAW_NO_STATEREPORT);
+
+    LayOutCircuits (circuits);
+    BeginPage();
+    for (auto& c : circuits) {
+        DrawCircuit (c.relay, c.exp, c.timer);
+        if (!PlaceRelayDrawing()) {
+            FinishPage();
+            BeginPage();
+            if (!PlaceRelayDrawing())       /* too big for any page */
+                continue;
+        }
+    }
+    FinishPage();
+
+    BeginPage();
+    ProduceRelayIndex (Plot, IndexMoreProc, TextFont, TitleFont, PlotPageWidth, BotLoc);
+    bool written = plot.Write (path, title);
+
+    Plot = NULL;
+    DeleteObject (TextFont);
+    DeleteObject (TitleFont);
+    CleanUpDrawing();
+    if (width > 0)
+        DrawingSetPageSize (width, height, canonm, flags);
+
+    if (!written)
+        usermsgstop ("Cannot write relay plot %s", path);
+    return written;
+}
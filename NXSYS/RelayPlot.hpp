@@ -0,0 +1,17 @@
+//
+//  RelayPlot.hpp
+//  NXSYS
+//
+//  The whole interlocking's relay circuits, as the printed set is, written
+//  to one SVG file without a printer or a window: every relay with expr
+//  code, in number order, packed onto landscape pages, then the index
+//  pages.  Every contact's relay name links to that relay's drawing, and
+//  every page number in the index to its page.
+//
+
+#ifndef RelayPlot_hpp
+#define RelayPlot_hpp
+
+bool PlotInterlocking (const char * path, const char * title);
+
+#endif /* RelayPlot_hpp */
@@ -0,0 +1,233 @@
+//
+//  SVGPlot.cpp
+//  NXSYS
+//
+//  Each page is a group translated down the document, below the one before
+//  it with a gap; lines drawn one after another are kept as one path until
+//  anything else is drawn, which keeps the file much smaller.
+//
+
+#include "windows.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "SVGPlot.hpp"
+
+static const int PageGap = 20;
+static const double TextWidth = .6;         /* of height, average */
+static const double TextAscent = .8;
+
+SVGPlot::SVGPlot (int page_width, int page_height, int font_height) :
+    PageWidth_(page_width), PageHeight_(page_height), FontHeight(font_height),
+    Black(false), X(0), Y(0), Moved(true) {}
+
+static std::string Escape (const char * s, int n) {
+    std::string e;
+    for (int i = 0; i < n; i++)
+        switch (s[i]) {
+            case '&': e += "&amp;"; break;
+            case '<': e += "&lt;"; break;
+            case '>': e += "&gt;"; break;
+            case '"': e += "&quot;"; break;
+            default:  e += s[i]; break;
+        }
+    return e;
+}
+
+std::string SVGPlot::Id (const std::string& name) {
+    std::string id = "r-";
+    for (char c : name)
+        if (isalnum ((unsigned char)c))
+            id += c;
+        else {
+            char buf[8];
+            snprintf (buf, sizeof(buf), "_%02X", (unsigned char)c);
+            id += buf;
+        }
+    return id;
+}
+
+std::string& SVGPlot::Out () {
+    if (Pages_.empty())
+        NewPage();
+    return Pages_.back();
+}
+
+void SVGPlot::Flush () {
+    if (Path.empty())
+        return;
+    Out() += "<path d=\"" + Path + "\"/>\n";
+    Path.clear();
+}
+
+void SVGPlot::NewPage () {
+    if (!Pages_.empty())
+        Flush();
+    Pages_.emplace_back();
+    X = Y = 0;
+    Links.clear();
+}
+
+void SVGPlot::DefineFont (HGDIOBJ font, int height) {
+    Fonts[font] = height;
+}
+
+void SVGPlot::Anchor (const std::string& name) {
+    Flush();
+    Out() += "<g id=\"" + Id(name) + "\">\n";
+}
+
+void SVGPlot::EndAnchor () {
+    Flush();
+    Out() += "</g>\n";
+}
+
+void SVGPlot::BeginLink (const std::string& name) {
+    std::string id = Id(name);
+    bool made = Anchors.count(id) != 0;
+    Links.push_back(made);
+    if (made) {
+        Flush();
+        Out() += "<a href=\"#" + id + "\">";
+    }
+}
+
+void SVGPlot::BeginPageLink (int page) {
+    Flush();
+    Links.push_back(true);
+    Out() += "<a href=\"#page-" + std::to_string(page) + "\">";
+}
+
+void SVGPlot::EndLink () {
+    if (Links.empty())
+        return;
+    if (Links.back()) {
+        Flush();
+        Out() += "</a>\n";
+    }
+    Links.pop_back();
+}
+
+void SVGPlot::Move (int x, int y) {
+    X = x;
+    Y = y;
+    Moved = true;
+}
+
+void SVGPlot::Line (int x, int y) {
+    char buf[64];
+    if (Moved || Path.empty())
+        snprintf (buf, sizeof(buf), "M%d %dL%d %d", X, Y, x, y);
+    else
+        snprintf (buf, sizeof(buf), "L%d %d", x, y);
+    Path += buf;
+    X = x;
+    Y = y;
+    Moved = false;
+}
+
+static const char * BrushColor (bool black) {
+    return black ? "#000" : "#fff";
+}
+
+void SVGPlot::Poly (const POINT * points, int n) {
+    Flush();
+    std::string& out = Out();
+    out += "<polygon class=\"b\" fill=\"";
+    out += BrushColor(Black);
+    out += "\" points=\"";
+    for (int i = 0; i < n; i++) {
+        char buf[32];
+        snprintf (buf, sizeof(buf), "%s%d,%d", i ? " " : "", (int)points[i].x, (int)points[i].y);
+        out += buf;
+    }
+    out += "\"/>\n";
+}
+
+void SVGPlot::Oval (int left, int top, int right, int bottom) {
+    Flush();
+    char buf[160];
+    snprintf (buf, sizeof(buf), "<ellipse class=\"b\" fill=\"%s\" cx=\"%g\" cy=\"%g\" rx=\"%g\" ry=\"%g\"/>\n",
+              BrushColor(Black), (left + right)/2.0, (top + bottom)/2.0,
+              (right - left)/2.0, (bottom - top)/2.0);
+    Out() += buf;
+}
+
+void SVGPlot::Fill (const RECT& r, HGDIOBJ brush) {
+    Flush();
+    char buf[128];
+    snprintf (buf, sizeof(buf), "<rect fill=\"%s\" x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\"/>\n",
+              BrushColor(brush == GetStockObject(BLACK_BRUSH)), (int)r.left, (int)r.top,
+              (int)(r.right - r.left), (int)(r.bottom - r.top));
+    Out() += buf;
+}
+
+void SVGPlot::Select (HGDIOBJ object) {
+    if (object == GetStockObject(BLACK_BRUSH))
+        Black = true;
+    else if (object == GetStockObject(WHITE_BRUSH))
+        Black = false;
+    else {
+        auto f = Fonts.find(object);
+        if (f != Fonts.end())
+            FontHeight = f->second;
+    }
+}
+
+/* As DrawText, single line, no clipping; the baseline is placed from the
+   cell the font's height makes. */
+int SVGPlot::Text (const char * s, int n, RECT * r, unsigned format) {
+    int width = (int)(TextWidth*FontHeight*n);
+    if (format & DT_CALCRECT) {
+        r->right = r->left + width;
+        r->bottom = r->top + FontHeight;
+        return FontHeight;
+    }
+    Flush();
+    const char * anchor = "start";
+    int x = r->left;
+    if (format & DT_CENTER) {
+        anchor = "middle";
+        x = (r->left + r->right)/2;
+    }
+    else if (format & DT_RIGHT) {
+        anchor = "end";
+        x = r->right;
+    }
+    int top = r->top;
+    if (format & DT_VCENTER)
+        top = (r->top + r->bottom - FontHeight)/2;
+    else if (format & DT_BOTTOM)
+        top = r->bottom - FontHeight;
+    char buf[128];
+    snprintf (buf, sizeof(buf), "<text x=\"%d\" y=\"%d\" font-size=\"%d\" text-anchor=\"%s\">",
+              x, top + (int)(TextAscent*FontHeight), FontHeight, anchor);
+    Out() += buf + Escape(s, n) + "</text>\n";
+    return FontHeight;
+}
+
+bool SVGPlot::Write (const char * path, const char * title) {
+    if (!Pages_.empty())
+        Flush();
+    FILE * f = fopen (path, "w");
+    if (f == NULL)
+        return false;
+    int pages = (int)Pages_.size();
+    int height = pages*(PageHeight_ + PageGap) + PageGap;
+    fprintf (f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+             "viewBox=\"0 0 %d %d\" font-family=\"Helvetica, Arial, sans-serif\">\n",
+             PageWidth_ + 2*PageGap, height, PageWidth_ + 2*PageGap, height);
+    fprintf (f, "<title>%s</title>\n", Escape(title, (int)strlen(title)).c_str());
+    fprintf (f, "<style>path,.b{stroke:#000;stroke-width:1}path{fill:none}"
+             "a text{fill:#00c}</style>\n<rect width=\"100%%\" height=\"100%%\" fill=\"#ddd\"/>\n");
+    for (int i = 0; i < pages; i++) {
+        fprintf (f, "<g id=\"page-%d\" transform=\"translate(%d %d)\">\n"
+                 "<rect width=\"%d\" height=\"%d\" fill=\"#fff\"/>\n",
+                 i + 1, PageGap, PageGap + i*(PageHeight_ + PageGap), PageWidth_, PageHeight_);
+        fputs (Pages_[i].c_str(), f);
+        fputs ("</g>\n", f);
+    }
+    fputs ("</svg>\n", f);
+    return fclose (f) == 0;
+}
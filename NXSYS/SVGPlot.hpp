@@ -0,0 +1,96 @@
+//
+//  SVGPlot.hpp
+//  NXSYS
+//
+//  A vector "device" for relay drawings and their index: pages of the same
+//  size, laid out down one SVG document, each with an id to link to.  The
+//  GDI calls the drawing code makes -- MoveTo, LineTo, Polygon, Ellipse,
+//  FillRect, DrawText, SelectObject -- are overloaded on it, so code written
+//  for an HDC draws on it unchanged when made a template on its device.
+//
+//  Fonts are only sizes; those to be selected are told it by DefineFont.
+//  Text is measured at an average width, which is all DT_CALCRECT is used
+//  for (sizing cells and frames).
+//
+
+#ifndef SVGPlot_hpp
+#define SVGPlot_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "PolyKludge.h"
+
+class SVGPlot {
+public:
+    SVGPlot (int page_width, int page_height, int font_height);
+
+    int PageWidth () const {return PageWidth_;}
+    int PageHeight () const {return PageHeight_;}
+    int Pages () const {return (int)Pages_.size();}
+    void NewPage ();                /* numbered from 1; drawing goes there */
+
+    void DefineFont (HGDIOBJ font, int height);
+
+    /* Named places, and links to them; a link to a name with no anchor
+       in the document is not made. */
+    static std::string Id (const std::string& name);
+    void Anchor (const std::string& name);
+    void EndAnchor ();
+    void Linkable (const std::string& name) {Anchors.insert(Id(name));}
+    void BeginLink (const std::string& name);
+    void BeginPageLink (int page);
+    void EndLink ();
+
+    bool Write (const char * path, const char * title);
+
+    /* Named so as not to meet the Windows macros. */
+    void Move (int x, int y);
+    void Line (int x, int y);
+    void Poly (const POINT * points, int n);
+    void Oval (int left, int top, int right, int bottom);
+    void Fill (const RECT& r, HGDIOBJ brush);
+    int Text (const char * s, int n, RECT * r, unsigned format);
+    void Select (HGDIOBJ object);
+
+private:
+    int PageWidth_, PageHeight_;
+    int FontHeight;
+    bool Black;                     /* the brush selected */
+    int X, Y;
+    bool Moved;                     /* since the last line */
+    std::string Path;               /* lines not yet written */
+    std::vector<std::string> Pages_;
+    std::map<HGDIOBJ, int> Fonts;
+    std::set<std::string> Anchors;
+    std::vector<bool> Links;        /* nesting of BeginLink, made or not */
+
+    std::string& Out ();
+    void Flush ();
+};
+
+/* GDI, on an SVGPlot. */
+inline void LineTo (SVGPlot * p, int x, int y) {p->Line(x, y);}
+#ifdef _WIN32
+inline void MoveToEx (SVGPlot * p, int x, int y, void *) {p->Move(x, y);}
+#else
+inline void MoveTo (SVGPlot * p, int x, int y) {p->Move(x, y);}
+#endif
+inline void Polygon (SVGPlot * p, const POINT * points, int n) {p->Poly(points, n);}
+inline void Ellipse (SVGPlot * p, int l, int t, int r, int b) {p->Oval(l, t, r, b);}
+inline void FillRect (SVGPlot * p, const RECT * r, HBRUSH brush) {p->Fill(*r, (HGDIOBJ)brush);}
+inline int DrawText (SVGPlot * p, const char * s, int n, RECT * r, unsigned format) {
+    return p->Text(s, n, r, format);
+}
+inline void SelectObject (SVGPlot * p, HGDIOBJ object) {p->Select(object);}
+
+/* Links, which mean something only on an SVGPlot. */
+inline void BeginRelayLink (HDC, const std::string&) {}
+inline void BeginPageLink (HDC, int) {}
+inline void EndLink (HDC) {}
+inline void BeginRelayLink (SVGPlot * p, const std::string& name) {p->BeginLink(name);}
+inline void BeginPageLink (SVGPlot * p, int page) {p->BeginPageLink(page);}
+inline void EndLink (SVGPlot * p) {p->EndLink();}
+
+#endif /* SVGPlot_hpp */
@@ -0,0 +1,54 @@
+//
+//  Snapshot.cpp
+//  NXSYS
+//
+//  Relays are restored first, as their reporters move panel objects, which
+//  turnouts, trains, timers and coders, restored after, then put right.  Track
+//  circuits take their occupancy from the restored trains, but don't report
+//  it, as the track relays were restored with the rest.
+//
+
+#include "windows.h"
+#include "nxsysapp.h"
+#include "loaddcls.h"
+#include "xtgtrack.h"
+#include "Snapshot.hpp"
+
+int CountRelaySyms();
+
+static const uint32_t SnapshotMagic = 0x4E58534E;     // "NXSN"
+static const uint32_t SnapshotVersion = 2;
+
+void TakeSnapshot (Snapshot& blob) {
+    blob.clear();
+    SnapshotWriter w(blob);
+    w.Put(SnapshotMagic);
+    w.Put(SnapshotVersion);
+    w.Put(InterlockingLoadSerial);
+    w.Put(CountRelaySyms());
+    SnapshotRelays(w);
+    SnapshotTurnouts(w);
+    SnapshotTrains(w);
+    SnapshotTimers(w);
+    SnapshotCoders(w);
+}
+
+bool RestoreSnapshot (const Snapshot& blob) {
+    SnapshotReader r(blob);
+    if (!InterlockingLoaded
+        || r.Get<uint32_t>() != SnapshotMagic
+        || r.Get<uint32_t>() != SnapshotVersion
+        || r.Get<long>() != InterlockingLoadSerial
+        || r.Get<int>() != CountRelaySyms())
+        return false;
+
+    RestoreRelays(r);
+    RestoreTurnouts(r);
+    DeferTrackCircuitReports();
+    RestoreTrains(r);
+    DiscardTrackCircuitReports();
+    RestoreTimers(r);
+    RestoreCoders(r);
+    InvalidateRect (G_mainwindow, NULL, 0);
+    return true;
+}
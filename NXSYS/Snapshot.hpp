@@ -0,0 +1,62 @@
+//
+//  Snapshot.hpp
+//  NXSYS
+//
+//  Snapshot and rewind of the running interlocking: relay states, pending
+//  timers with their remaining times, turnout positions and motion, trains,
+//  track circuit occupancy and coders, as a flat binary blob.  A snapshot
+//  holds pointers into the loaded interlocking, so it is good only for the
+//  same load in the same run; restoring it elsewhere is refused.
+//
+
+#ifndef Snapshot_hpp
+#define Snapshot_hpp
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+typedef std::vector<unsigned char> Snapshot;
+
+class SnapshotWriter {
+public:
+    SnapshotWriter(Snapshot& blob) : Blob(blob) {}
+    template <class T> void Put (const T& v) {
+        const unsigned char * p = reinterpret_cast<const unsigned char*>(&v);
+        Blob.insert(Blob.end(), p, p + sizeof(T));
+    }
+private:
+    Snapshot& Blob;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const Snapshot& blob) : P(blob.data()), End(blob.data() + blob.size()) {}
+    template <class T> T Get () {
+        T v {};
+        if ((size_t)(End - P) >= sizeof(T)) {
+            memcpy(&v, P, sizeof(T));
+            P += sizeof(T);
+        }
+        return v;
+    }
+private:
+    const unsigned char * P, * End;
+};
+
+void TakeSnapshot (Snapshot& blob);
+bool RestoreSnapshot (const Snapshot& blob);   // false if not of this load
+
+/* Each subsystem's part, in this order, which is the order of restoring. */
+void SnapshotRelays (SnapshotWriter&);
+void RestoreRelays (SnapshotReader&);
+void SnapshotTurnouts (SnapshotWriter&);
+void RestoreTurnouts (SnapshotReader&);
+void SnapshotTrains (SnapshotWriter&);
+void RestoreTrains (SnapshotReader&);
+void SnapshotTimers (SnapshotWriter&);
+void RestoreTimers (SnapshotReader&);
+void SnapshotCoders (SnapshotWriter&);
+void RestoreCoders (SnapshotReader&);
+
+#endif /* Snapshot_hpp */
@@ -0,0 +1,330 @@
+//
+//  TimerWheel.cpp
+//  NXSYS
+//
+//  The wheel, and the NXTimer interface (timers.h) built on it, formerly in
+//  each platform's timer module, which now only supplies the one real timer.
+//
+
+#include "windows.h"
+#include <cassert>
+#include "timers.h"
+#include "TimerWheel.hpp"
+#include "Snapshot.hpp"
+
+TimerWheel::TimerWheel () : Halted(false), Now(0), Count(0) {
+    for (auto& level : Heads)
+        for (auto& head : level)
+            head.Next = head.Prev = &head;
+}
+
+TimerWheel::~TimerWheel () {
+    Clear();
+    for (Node * n : FreeNodes)
+        delete n;
+}
+
+/* The level is the coarsest whose slot the timer will not pass through
+   before its time; the slot is that level's digit of the due time. */
+void TimerWheel::Insert (Node * n) {
+    uint32_t delta = n->Due - Now;
+    int level = 0;
+    while (level < Levels - 1 && (delta >> (Bits * (level + 1))) != 0)
+        level++;
+    Node * head = &Heads[level][(n->Due >> (Bits * level)) & (Slots - 1)];
+    n->Next = head;
+    n->Prev = head->Prev;
+    head->Prev->Next = n;
+    head->Prev = n;
+}
+
+void TimerWheel::Unlink (Node * n) {
+    n->Prev->Next = n->Next;
+    n->Next->Prev = n->Prev;
+    if (n->ObjNext)
+        n->ObjNext->ObjPrev = n->ObjPrev;
+    if (n->ObjPrev)
+        n->ObjPrev->ObjNext = n->ObjNext;
+    else if (n->ObjNext)
+        ByObject[n->Object] = n->ObjNext;
+    else
+        ByObject.erase(n->Object);
+    Count--;
+    FreeNodes.push_back(n);
+}
+
+void TimerWheel::Arm (void * object, Fn fn, uint32_t due) {
+    if ((int32_t)(due - Now) <= 0)          /* wrap-safe */
+        due = Now + 1;
+    Node * n;
+    if (FreeNodes.empty())
+        n = new Node;
+    else {
+        n = FreeNodes.back();
+        FreeNodes.pop_back();
+    }
+    n->Object = object;
+    n->Function = fn;
+    n->Due = due;
+    Node*& first = ByObject[object];
+    n->ObjPrev = nullptr;
+    n->ObjNext = first;
+    if (first)
+        first->ObjPrev = n;
+    first = n;
+    Insert(n);
+    Count++;
+}
+
+void TimerWheel::Cancel (void * object) {
+    auto it = ByObject.find(object);
+    if (it == ByObject.end())
+        return;
+    Node * n = it->second;
+    ByObject.erase(it);
+    while (n) {
+        Node * next = n->ObjNext;
+        n->Prev->Next = n->Next;
+        n->Next->Prev = n->Prev;
+        Count--;
+        FreeNodes.push_back(n);
+        n = next;
+    }
+}
+
+void TimerWheel::Clear () {
+    for (auto& level : Heads)
+        for (auto& head : level) {
+            for (Node * n = head.Next; n != &head; ) {
+                Node * next = n->Next;
+                FreeNodes.push_back(n);
+                n = next;
+            }
+            head.Next = head.Prev = &head;
+        }
+    ByObject.clear();
+    Count = 0;
+}
+
+void TimerWheel::SetClock (uint32_t clock) {
+    assert(Count == 0);
+    Now = clock;
+}
+
+/* The level below has just wrapped; its timers due in the coming stretch
+   move down.  The level above goes first, as it may have wrapped too. */
+void TimerWheel::Cascade (int level) {
+    if (level >= Levels)
+        return;
+    uint32_t idx = (Now >> (Bits * level)) & (Slots - 1);
+    if (idx == 0)
+        Cascade(level + 1);
+    Node * head = &Heads[level][idx];
+    Node * n = head->Next;
+    head->Next = head->Prev = head;
+    while (n != head) {
+        Node * next = n->Next;
+        Insert(n);
+        n = next;
+    }
+}
+
+/* Nothing is ever armed for Now itself, so anything in its slot was left by
+   a halt, and goes first. */
+void TimerWheel::Advance (uint32_t until) {
+    while (!Halted) {
+        Node * head = &Heads[0][Now & (Slots - 1)];
+        while (head->Next != head && !Halted) {
+            Node * n = head->Next;
+            void * object = n->Object;
+            Fn fn = n->Function;
+            Unlink(n);
+            fn(object);                 // may arm and cancel at will
+        }
+        if (Halted || (int32_t)(until - Now) <= 0)
+            return;
+        uint32_t wake = NextWake();
+        if (Count == 0 || (int32_t)(wake - until) > 0) {
+            Now = until;                // nothing between; no cascade is due
+            return;
+        }
+        Now = wake;
+        if ((Now & (Slots - 1)) == 0)
+            Cascade(1);
+    }
+}
+
+/* The earliest time Advance has anything to do: a level-0 slot with timers,
+   or the start of a coarser slot, to be cascaded, that has any.  A level's
+   timers can lie past its wrap, so each level is looked at all the way round. */
+uint32_t TimerWheel::NextWake () const {
+    uint32_t best = 0;                  // as an offset from Now; 0 = none yet
+    for (int level = 0; level < Levels; level++) {
+        uint32_t base = Now >> (Bits * level);
+        for (uint32_t j = 1; j <= Slots; j++) {
+            const Node * head = &Heads[level][(base + j) & (Slots - 1)];
+            if (head->Next != head) {
+                uint32_t offset = ((base + j) << (Bits * level)) - Now;
+                if (best == 0 || offset < best)
+                    best = offset;
+                break;
+            }
+        }
+    }
+    return Now + (best ? best : 1);
+}
+
+/* Move the clock from "from" to "to", the timers keeping the time they had
+   left, e.g., in and out of virtual time. */
+void TimerWheel::Rebase (uint32_t from, uint32_t to) {
+    std::vector<Node*> nodes;
+    for (auto& level : Heads)
+        for (auto& head : level) {
+            for (Node * n = head.Next; n != &head; n = n->Next)
+                nodes.push_back(n);
+            head.Next = head.Prev = &head;
+        }
+    Now = to;
+    for (Node * n : nodes) {
+        int32_t left = (int32_t)(n->Due - from);
+        n->Due = to + (uint32_t)(left > 0 ? left : 1);
+        Insert(n);
+    }
+}
+
+std::vector<TimerWheel::Entry> TimerWheel::Entries () const {
+    std::vector<Entry> entries;
+    for (auto& level : Heads)
+        for (auto& head : level)
+            for (const Node * n = head.Next; n != &head; n = n->Next)
+                entries.push_back({n->Object, n->Function, n->Due});
+    return entries;
+}
+
+
+static TimerWheel Wheel;
+static bool VirtualTime = false;
+static bool PlatformTimerSet = false;
+static DWORD PlatformTimerDue = 0;
+
+static DWORD RealNow () {
+    return (DWORD)GetTickCount();
+}
+
+DWORD NXTimerNow () {
+    return VirtualTime ? (DWORD)Wheel.Clock() : RealNow();
+}
+
+static void ArmPlatformTimer () {
+    if (VirtualTime || Wheel.Halted || Wheel.Empty())
+        return;
+    DWORD wake = Wheel.NextWake();
+    if (PlatformTimerSet) {
+        if ((int)(wake - PlatformTimerDue) >= 0)
+            return;
+        KillPlatformTimer();
+    }
+    DWORD now = RealNow();
+    SetPlatformTimer ((int)(wake - now) > 0 ? (long)(wake - now) : 0);
+    PlatformTimerSet = true;
+    PlatformTimerDue = wake;
+}
+
+void PlatformTimerFired () {
+    PlatformTimerSet = false;
+    if (!Wheel.Halted && !Wheel.Empty())
+        Wheel.Advance (RealNow());
+    ArmPlatformTimer();
+}
+
+/* Waking the platform timer at the new timer's own time is early enough,
+   as Advance steps through whatever comes between. */
+void NXTimer (void* object, NXTimerFn fn, long ms) {
+    DWORD now = NXTimerNow();
+    DWORD due = now + (DWORD)ms;
+    if (Wheel.Empty())
+        Wheel.SetClock (now);
+    Wheel.Arm (object, fn, due);
+    if (VirtualTime || Wheel.Halted
+        || (PlatformTimerSet && (int)(due - PlatformTimerDue) >= 0))
+        return;
+    if (PlatformTimerSet)
+        KillPlatformTimer();
+    SetPlatformTimer (ms > 0 ? ms : 0);
+    PlatformTimerSet = true;
+    PlatformTimerDue = due;
+}
+
+/* This is really "purge one Object from the timer system" */
+void KillOneTimer (void* object) {
+    Wheel.Cancel (object);
+}
+
+void KillNXTimers () {
+    Wheel.Clear();
+    if (PlatformTimerSet)
+        KillPlatformTimer();
+    PlatformTimerSet = false;
+    ResetCoders();
+}
+
+void RunTimers () {
+    Wheel.Halted = false;
+    if (!VirtualTime && !Wheel.Empty())
+        Wheel.Advance (RealNow());
+    ArmPlatformTimer();
+}
+
+void HaltTimers() {
+    Wheel.Halted = true;
+}
+
+void SetVirtualTime (bool on) {
+    if (on == VirtualTime)
+        return;
+    if (on) {
+        if (PlatformTimerSet)
+            KillPlatformTimer();
+        PlatformTimerSet = false;
+        DWORD now = RealNow();
+        Wheel.Rebase (now, now);    // overdue timers now due next
+        VirtualTime = true;
+    }
+    else {
+        VirtualTime = false;
+        Wheel.Rebase (Wheel.Clock(), RealNow());
+        ArmPlatformTimer();
+    }
+}
+
+/* Halted timers don't age; the clock goes on. */
+void AdvanceVirtualTime (long ms) {
+    uint32_t until = Wheel.Clock() + (uint32_t)ms;
+    Wheel.Advance (until);
+    if (Wheel.Clock() != until)
+        Wheel.Rebase (Wheel.Clock(), until);
+}
+
+/* Snapshot and rewind (Snapshot.hpp).  Timers are saved with the time they
+   had left, and replace all pending timers on restoring. */
+void SnapshotTimers (SnapshotWriter& w) {
+    DWORD now = NXTimerNow();
+    std::vector<TimerWheel::Entry> entries = Wheel.Entries();
+    w.Put(entries.size());
+    for (auto& e : entries) {
+        w.Put(e.Object);
+        w.Put(e.Function);
+        w.Put((long)(int32_t)(e.Due - now));
+    }
+}
+
+void RestoreTimers (SnapshotReader& r) {
+    Wheel.Clear();
+    size_t n = r.Get<size_t>();
+    for (size_t i = 0; i < n; i++) {
+        void * object = r.Get<void*>();
+        NXTimerFn fn = r.Get<NXTimerFn>();
+        long left = r.Get<long>();
+        NXTimer (object, fn, left > 0 ? left : 0);
+    }
+}
@@ -0,0 +1,75 @@
+//
+//  TimerWheel.hpp
+//  NXSYS
+//
+//  Hierarchical timing wheel under NXTimer: four levels of 256 slots, of 1 ms,
+//  256 ms, 65 s and 4.6 hours, covering the whole 32-bit millisecond clock.
+//  Arming and cancelling are O(1); each millisecond the clock passes costs
+//  one slot, and a slot of a coarser level is cascaded down as the finer one
+//  wraps.  The whole system needs only one platform timer, set for the next
+//  slot that holds anything.
+//
+
+#ifndef TimerWheel_hpp
+#define TimerWheel_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+class TimerWheel {
+public:
+    typedef void (*Fn)(void*);
+    struct Entry {
+        void * Object;
+        Fn Function;
+        uint32_t Due;
+    };
+
+    TimerWheel();
+    ~TimerWheel();
+    void Arm (void * object, Fn fn, uint32_t due);
+    void Cancel (void * object);            // all of object's timers
+    void Clear ();
+    void Advance (uint32_t until);          // matures, in time order
+    void Rebase (uint32_t from, uint32_t to);
+    uint32_t NextWake () const;
+    uint32_t Clock () const {return Now;}
+    void SetClock (uint32_t clock);         // only when empty
+    bool Empty () const {return Count == 0;}
+    std::vector<Entry> Entries () const;
+
+    bool Halted;                            // Advance stops where it is
+
+private:
+    static const int Bits = 8;
+    static const int Slots = 1 << Bits;
+    static const int Levels = 4;
+
+    struct Node {
+        Node * Next, * Prev;                // in its slot, circular
+        Node * ObjNext, * ObjPrev;          // among its object's timers
+        void * Object;
+        Fn Function;
+        uint32_t Due;
+    };
+
+    Node Heads[Levels][Slots];              // list heads
+    std::unordered_map<void*, Node*> ByObject;
+    std::vector<Node*> FreeNodes;
+    uint32_t Now;
+    size_t Count;
+
+    void Insert (Node * n);
+    void Unlink (Node * n);
+    void Cascade (int level);
+};
+
+/* The platform timer module supplies one one-shot timer, and calls
+   PlatformTimerFired when it goes off. */
+void SetPlatformTimer (long ms);
+void KillPlatformTimer ();
+void PlatformTimerFired ();
+
+#endif /* TimerWheel_hpp */
@@ -0,0 +1,229 @@
+#include "windows.h"
+#include <vector>
+#include <unordered_map>
+#include "timers.h"
+#include "nxgo.h"
+#include "Snapshot.hpp"
+
+/* "Coded" is TA talk for "Flashing electricity" -- the point of the Coder
+    system is to make all flashing lights flash in unison as though they
+    really were fed from one coded source (and to reduce the number of
+    timers, although for switches, it won't). */
+
+/* Formerly in duplicate in the Windows and Mac timer modules.  Both code
+   rates are now driven by one clock counting CodeTicks, which divide both
+   blips, so the two stay phase-locked, as real code transmitters on one
+   frame would, and a blip of either rate costs one NXTimer, virtual time
+   included.  The clock only wakes at ticks where some rate with live coders
+   flips phase.
+
+   Each rate keeps a dense list of its coders, and a map from object (which
+   is the caller's handle) to slot, so that registering and killing are O(1).
+   The objects' invalidations during a blip are merged into one repaint. */
+
+const int CodeBlipMS = 300;
+const int FastCodeBlipMS = 120;
+const int CodeTickMS = 60;
+
+static long CodeTick = 0;		/* also the clock's NXTimer object */
+static long NextTick = 0;
+static DWORD TickTime = 0;		/* NXTimerNow() at CodeTick */
+static bool ClockRunning = false;
+static bool Blipping = false;
+
+struct Coder {
+    void * Object;			/* NULL: killed during the blip */
+    CoderFn Function;
+};
+
+class CodersCtl {
+    public:
+	long Period;			/* in CodeTicks */
+	bool Holes;
+	std::vector <Coder> Coders;
+	std::unordered_map <void*, size_t> Slots;
+
+    public:
+	CodersCtl(int blip_ms) : Period(blip_ms / CodeTickMS), Holes(false) {}
+	BOOL Phase () {return (BOOL)((CodeTick / Period) & 1);}
+	long NextDue (long tick) {return (tick / Period + 1) * Period;}
+	void Reset();
+	void Blip ();
+	void Compact();
+	void Register(void * object, CoderFn fn);
+	void KillOne (void * object);
+};
+
+static CodersCtl StdCoders(CodeBlipMS);
+static CodersCtl FastCoders(FastCodeBlipMS);
+static CodersCtl * const AllCoders[] = {&StdCoders, &FastCoders};
+
+static void CodeClockFn (void *);
+
+static void ScheduleClock () {
+    NextTick = 0;
+    for (auto c : AllCoders)
+	if (!c->Coders.empty()) {
+	    long due = c->NextDue (CodeTick);
+	    if (NextTick == 0 || due < NextTick)
+		NextTick = due;
+	}
+    ClockRunning = (NextTick != 0);
+    if (ClockRunning)
+	NXTimer (&CodeTick, CodeClockFn, (NextTick - CodeTick) * CodeTickMS);
+}
+
+/* c has just got its first coder.  A faster rate joining a running clock
+   may need it sooner than it was going to wake. */
+static void WantClockFor (CodersCtl * c) {
+    if (Blipping)			/* rescheduled at the end of the blip */
+	return;
+    if (!ClockRunning) {
+	TickTime = NXTimerNow();
+	ScheduleClock();
+	return;
+    }
+    long now_tick = CodeTick + (long)(NXTimerNow() - TickTime) / CodeTickMS;
+    if (c->NextDue (now_tick) >= NextTick)
+	return;
+    KillOneTimer (&CodeTick);
+    TickTime += (DWORD)((now_tick - CodeTick) * CodeTickMS);
+    CodeTick = now_tick;
+    ScheduleClock();
+}
+
+static void CodeClockFn (void *) {
+    ClockRunning = false;
+    CodeTick = NextTick;
+    TickTime = NXTimerNow();
+    Blipping = true;
+    {
+	InvalidationBatch batch;
+	for (auto c : AllCoders)
+	    if (CodeTick % c->Period == 0)
+		c->Blip();
+    }
+    Blipping = false;
+    for (auto c : AllCoders)
+	c->Compact();
+    ScheduleClock();
+}
+
+void CodersCtl::Reset () {
+    Coders.clear();
+    Slots.clear();
+    Holes = false;
+}
+
+void ResetCoders () {
+    StdCoders.Reset();
+    FastCoders.Reset();
+    ClockRunning = Blipping = false;
+}
+
+void CodersCtl::Blip () {
+    BOOL p = Phase();
+    /* Coders registered during the blip were called at registration. */
+    size_t n = Coders.size();
+    for (size_t i = 0; i < n; i++)
+	if (Coders[i].Object != NULL)
+	    Coders[i].Function (Coders[i].Object, p);
+}
+
+void CodersCtl::Compact () {
+    if (!Holes)
+	return;
+    size_t j = 0;
+    for (size_t i = 0; i < Coders.size(); i++)
+	if (Coders[i].Object != NULL) {
+	    Slots[Coders[i].Object] = j;
+	    Coders[j++] = Coders[i];
+	}
+    Coders.resize(j);
+    Holes = false;
+}
+
+/* An object coding for two reasons at once (a switch both moving and
+   CLK-flashing) is one coder. */
+void CodersCtl::Register (void * object, CoderFn fn) {
+    auto it = Slots.find(object);
+    if (it != Slots.end())
+	Coders[it->second].Function = fn;
+    else {
+	Slots[object] = Coders.size();
+	Coders.push_back({object, fn});
+	if (Coders.size() == 1)
+	    WantClockFor (this);
+    }
+    fn (object, Phase());
+}
+
+void CodersCtl::KillOne (void* data) {
+    auto it = Slots.find(data);
+    if (it == Slots.end())
+	return;
+    size_t i = it->second;
+    Slots.erase(it);
+    if (Blipping) {			/* don't move what the blip is walking */
+	Coders[i].Object = NULL;
+	Holes = true;
+	return;
+    }
+    if (i != Coders.size() - 1) {
+	Coders[i] = Coders.back();
+	Slots[Coders[i].Object] = i;
+    }
+    Coders.pop_back();
+    if (ClockRunning && StdCoders.Coders.empty() && FastCoders.Coders.empty()) {
+	KillOneTimer (&CodeTick);
+	ClockRunning = false;
+    }
+}
+
+void NXCoder (void* object, CoderFn fn) {
+    StdCoders.Register (object, fn);
+}
+void NXFastCoder (void* object, CoderFn fn) {
+    FastCoders.Register (object, fn);
+}
+
+void KillOneCoder (void* data) {
+    StdCoders.KillOne (data);
+}
+
+void KillOneFastCoder (void* data) {	/* hey, not me!!! */
+    FastCoders.KillOne (data);
+}
+
+/* Snapshot and rewind (Snapshot.hpp).  The clock's own NXTimer is restored
+   with the rest of the timers; the coders are put back in phase at once. */
+void SnapshotCoders (SnapshotWriter& w) {
+    w.Put(CodeTick);
+    w.Put(NextTick);
+    w.Put(ClockRunning);
+    w.Put((long)(NXTimerNow() - TickTime));
+    for (auto c : AllCoders) {
+	c->Compact();
+	w.Put(c->Coders.size());
+	for (auto& coder : c->Coders)
+	    w.Put(coder);
+    }
+}
+
+void RestoreCoders (SnapshotReader& r) {
+    CodeTick = r.Get<long>();
+    NextTick = r.Get<long>();
+    ClockRunning = r.Get<bool>();
+    TickTime = NXTimerNow() - (DWORD)r.Get<long>();
+    InvalidationBatch batch;
+    for (auto c : AllCoders) {
+	c->Reset();
+	size_t n = r.Get<size_t>();
+	for (size_t i = 0; i < n; i++) {
+	    Coder coder = r.Get<Coder>();
+	    c->Slots[coder.Object] = c->Coders.size();
+	    c->Coders.push_back(coder);
+	    coder.Function (coder.Object, c->Phase());
+	}
+    }
+}
@@ -23,6 +23,14 @@
 #include <string>
 #include <exception>
 #include "STLExtensions.h"
+#include "CapacitySimulation.hpp"
+#include "Snapshot.hpp"
+#include "MonteCarlo.hpp"
+#include "rlytrapi.h"
+#include "RelayJournal.hpp"
+#include "PanelImage.hpp"
+#include "RelayPlot.hpp"
+#include <map>
 
 /* Remodularized/rewritten/C++11 for no good reason 26 Sept 2019 */
 
@@ -97,6 +105,13 @@ static  GraphicObject *  FindDemoObjectByID (long nomen, TypeId type) {
 
 
 void DemoTrain (Sexpr);
+static void DemoCapacity (Sexpr);
+static void DemoSnapshot (Sexpr, bool restore);
+static void DemoMonteCarlo (Sexpr);
+static void DemoJournal (Sexpr);
+static void DemoJournalQuery (Sexpr);
+static void DemoPanelImage (Sexpr);
+static void DemoRelayPlot (Sexpr);
 
 #ifndef NXSYSMac
 RECT RR;
@@ -239,12 +254,15 @@ static bool ProcessForm (Sexpr s, int mousecmd = WM_LBUTTONDOWN) {
         State.reset();
         return true;
     }
-    if (s.type != Lisp::tCONS || CDR(s).type != Lisp::tCONS)
+    if (s.type != Lisp::tCONS)
         throw DemoErr ("Non-list in demo script.");
     if (CAR(s).type != Lisp::ATOM)
         throw DemoErr ("Non-atom at head of Demo command list.");
     
     std::string name = CAR(s).u.a;
+    /* (JOURNAL) alone, which stops the journal, is the only bare form */
+    if (CDR(s).type != Lisp::tCONS && name != "JOURNAL")
+        throw DemoErr ("Non-list in demo script.");
     if (name == "OPTIONS")
         DecodeOptions(CDR(s));
     else if (name == "VERSION") {
@@ -297,6 +315,34 @@ static bool ProcessForm (Sexpr s, int mousecmd = WM_LBUTTONDOWN) {
     else if (name == "TRAIN")
         DemoTrain (CDR (s));    /* continue, no time */
 
+    else if (name == "CAPACITY")
+        DemoCapacity (CDR (s)); /* runs to completion on virtual time */
+    else if (name == "MONTECARLO")
+        DemoMonteCarlo (CDR (s)); /* likewise */
+
+    else if (name == "TRACEDUMP") {
+        if (CADR(s).type != Lisp::STRING)
+            throw DemoErr ("Missing file name in TRACEDUMP.");
+        std::string path = State->ExpandPath(CADR(s).u.s);
+        if (!DumpRelayTrace (path.c_str()))
+            throw DemoErr (std::string("Cannot write relay trace to ") + path);
+    }
+
+    else if (name == "JOURNAL")
+        DemoJournal (CDR (s));
+    else if (name == "JOURNALQUERY")
+        DemoJournalQuery (CDR (s));
+
+    else if (name == "PANELIMAGE")
+        DemoPanelImage (CDR (s));
+    else if (name == "RELAYPLOT")
+        DemoRelayPlot (CDR (s));
+
+    else if (name == "SNAPSHOT")
+        DemoSnapshot (CDR (s), false);
+    else if (name == "RESTORE")
+        DemoSnapshot (CDR (s), true);
+
     else if (name == "CIRCUIT")
         for (Sexpr q = CDR (s); q != NIL; q= CDR(q)) {
             Sexpr e = CAR(q);
@@ -476,6 +522,251 @@ void DemoTrain (Sexpr S) {
     }
 }
 
+/* (CAPACITY hours "report-file" (entry-ij headway-secs) ...) */
+static void DemoCapacity (Sexpr S) {
+    if (S.type != Lisp::tCONS || !NUMBERP(CAR(S)))
+        throw DemoErr ("Missing number of hours in CAPACITY.");
+    double hours = *LCoerceToFloat(CAR(S)).u.f;
+    SPop(S);
+
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing report file name in CAPACITY.");
+    std::string report = State->ExpandPath(CAR(S).u.s);
+    SPop(S);
+
+    std::vector<CapacityEntry> entries;
+    for (; S.type == Lisp::tCONS; SPop(S)) {
+        Sexpr e = CAR(S);
+        if (e.type != Lisp::tCONS || CAR(e).type != Lisp::NUM
+            || CDR(e).type != Lisp::tCONS || CADR(e).type != Lisp::NUM)
+            throw DemoErr ("CAPACITY entry not (track-end-IJ headway-seconds).");
+        entries.push_back({CAR(e).u.n, CADR(e).u.n});
+    }
+    if (entries.empty())
+        throw DemoErr ("No entries in CAPACITY.");
+
+    DemoSay (FormatString("Simulating %.2f hours of trains...", hours).c_str());
+    if (!RunCapacitySimulation (hours, entries, report.c_str()))
+        throw DemoErr ("Capacity simulation failed.");
+    DemoSay (FormatString("Capacity report written to %s", report.c_str()).c_str());
+}
+
+/* (MONTECARLO scenarios minutes first-seed "report-file" entry-ij ...) */
+static void DemoMonteCarlo (Sexpr S) {
+    MonteCarloSpec spec;
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::NUM)
+        throw DemoErr ("Missing number of scenarios in MONTECARLO.");
+    spec.Scenarios = CAR(S).u.n;
+    SPop(S);
+
+    if (S.type != Lisp::tCONS || !NUMBERP(CAR(S)))
+        throw DemoErr ("Missing minutes per scenario in MONTECARLO.");
+    spec.Minutes = *LCoerceToFloat(CAR(S)).u.f;
+    SPop(S);
+
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::NUM)
+        throw DemoErr ("Missing first seed in MONTECARLO.");
+    spec.FirstSeed = CAR(S).u.n;
+    SPop(S);
+
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing report file name in MONTECARLO.");
+    std::string report = State->ExpandPath(CAR(S).u.s);
+    SPop(S);
+
+    for (; S.type == Lisp::tCONS; SPop(S)) {
+        if (CAR(S).type != Lisp::NUM)
+            throw DemoErr ("MONTECARLO entry not a track-end IJ number.");
+        spec.EntryIJs.push_back(CAR(S).u.n);
+    }
+
+    DemoSay (FormatString("Running %ld scenarios...", spec.Scenarios).c_str());
+    if (!RunMonteCarlo (spec, report.c_str()))
+        throw DemoErr ("Monte Carlo run failed.");
+    DemoSay (FormatString("Monte Carlo report written to %s", report.c_str()).c_str());
+}
+
+/* (SNAPSHOT name) and (RESTORE name), name an atom or a string.  Snapshots
+   last for the run, but can only be restored to the interlocking they
+   were taken of. */
+static std::map<std::string, Snapshot> Snapshots;
+
+static void DemoSnapshot (Sexpr S, bool restore) {
+    const char * form = restore ? "RESTORE" : "SNAPSHOT";
+    std::string name;
+    if (CAR(S).type == Lisp::ATOM)
+        name = CAR(S).u.a;
+    else if (CAR(S).type == Lisp::STRING)
+        name = CAR(S).u.s;
+    else
+        throw DemoErr (FormatString("Missing snapshot name in %s.", form));
+
+    if (!restore)
+        TakeSnapshot (Snapshots[name]);
+    else if (Snapshots.count(name) == 0)
+        throw DemoErr (FormatString("No snapshot named %s to RESTORE.", name.c_str()));
+    else if (!RestoreSnapshot (Snapshots[name]))
+        throw DemoErr (FormatString("Snapshot %s is not of this interlocking.", name.c_str()));
+}
+
+/* (JOURNAL "file") starts journaling relay activity to the file, and
+   (JOURNAL) stops.  Loading another interlocking stops it too. */
+static void DemoJournal (Sexpr S) {
+    if (S.type != Lisp::tCONS) {
+        StopRelayJournal();
+        return;
+    }
+    if (CAR(S).type != Lisp::STRING)
+        throw DemoErr ("JOURNAL file name not a string.");
+    std::string path = State->ExpandPath(CAR(S).u.s);
+    if (!StartRelayJournal (path.c_str()))
+        throw DemoErr (std::string("Cannot write relay journal ") + path);
+}
+
+static uint32_t JournalQueryMS (Sexpr s, const char * what) {
+    if (!NUMBERP(s))
+        throw DemoErr (FormatString("Missing %s seconds in JOURNALQUERY.", what));
+    return (uint32_t)(*LCoerceToFloat(s).u.f * 1000.0);
+}
+
+static std::string JournalQuerySecs (uint32_t ms) {
+    return FormatString("%lu.%03lu", (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+}
+
+/* The operands of a query, which must be just n of them. */
+static void JournalQueryArgs (Sexpr q, int n, const char * op) {
+    int count = 0;
+    for (; q.type == Lisp::tCONS; SPop(q))
+        count++;
+    if (count != n || q != NIL)
+        throw DemoErr (FormatString("JOURNALQUERY %s needs %d operands.", op, n));
+}
+
+static uint32_t JournalQueryRelay (const RelayJournal& j, Sexpr s) {
+    std::string name;
+    if (s.type == Lisp::RLYSYM)
+        name = s.u.r->PRep();
+    else if (s.type == Lisp::STRING)
+        name = s.u.s;
+    else
+        throw DemoErr ("Missing relay in JOURNALQUERY.");
+    uint32_t id;
+    if (!j.FindRelay(name, id))
+        throw DemoErr (FormatString("No relay %s in journal.", name.c_str()));
+    return id;
+}
+
+/* (JOURNALQUERY "journal" "report-file" query ...), each query one of
+       (STATE relay seconds)
+       (TRANSITIONS relay from-seconds to-seconds)
+       (REPLAY checkpoint-number to-seconds)
+   seconds being since the journal was started. */
+static void DemoJournalQuery (Sexpr S) {
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing journal file name in JOURNALQUERY.");
+    std::string path = State->ExpandPath(CAR(S).u.s);
+    SPop(S);
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing report file name in JOURNALQUERY.");
+    std::string report = State->ExpandPath(CAR(S).u.s);
+    SPop(S);
+
+    RelayJournal j;
+    if (!j.Load (path.c_str()))
+        throw DemoErr (std::string("Cannot read relay journal ") + path);
+    FILE * f = fopen (report.c_str(), "w");
+    if (f == NULL)
+        throw DemoErr (std::string("Cannot write journal report ") + report);
+    static const char * const kinds[] = {"", "REPORT", "TOGGLE", "PULSE", "TIMER"};
+    auto event_line = [&](const RelayJournal::Event& e) {
+        fprintf (f, "  %12s  %-6s  %s  %s\n", JournalQuerySecs(e.Time).c_str(),
+                 kinds[(int)e.Kind], e.State ? "PICK" : "DROP", j.Name(e.Relay).c_str());
+    };
+
+    fprintf (f, "Journal %s: %d relays, %d checkpoints\n", path.c_str(),
+             (int)j.Relays(), (int)j.Checkpoints().size());
+    try {
+        for (; S.type == Lisp::tCONS; SPop(S)) {
+            Sexpr q = CAR(S);
+            if (q.type != Lisp::tCONS || CAR(q).type != Lisp::ATOM)
+                throw DemoErr ("JOURNALQUERY query not a list.");
+            std::string op = CAR(q).u.a;
+            SPop(q);
+            if (op == "STATE") {
+                JournalQueryArgs (q, 2, "STATE");
+                uint32_t id = JournalQueryRelay (j, CAR(q));
+                uint32_t t = JournalQueryMS (CADR(q), "STATE");
+                int state = j.StateAt (id, t);
+                fprintf (f, "\n%s at %s: %s\n", j.Name(id).c_str(), JournalQuerySecs(t).c_str(),
+                         state < 0 ? "unknown" : state ? "PICKED" : "DROPPED");
+            }
+            else if (op == "TRANSITIONS") {
+                JournalQueryArgs (q, 3, "TRANSITIONS");
+                uint32_t id = JournalQueryRelay (j, CAR(q));
+                uint32_t from = JournalQueryMS (CADR(q), "TRANSITIONS from");
+                uint32_t to = JournalQueryMS (CADR(CDR(q)), "TRANSITIONS to");
+                fprintf (f, "\n%s from %s to %s\n", j.Name(id).c_str(),
+                         JournalQuerySecs(from).c_str(), JournalQuerySecs(to).c_str());
+                for (auto& e : j.Transitions (id, from, to))
+                    event_line (e);
+            }
+            else if (op == "REPLAY") {
+                JournalQueryArgs (q, 2, "REPLAY");
+                if (CAR(q).type != Lisp::NUM || CAR(q).u.n < 0
+                    || (size_t)CAR(q).u.n >= j.Checkpoints().size())
+                    throw DemoErr ("REPLAY checkpoint number not in journal.");
+                size_t n = (size_t)CAR(q).u.n;
+                uint32_t to = JournalQueryMS (CADR(q), "REPLAY to");
+                fprintf (f, "\nFrom checkpoint %d at %s to %s\n", (int)n,
+                         JournalQuerySecs(j.Checkpoints()[n].Time).c_str(),
+                         JournalQuerySecs(to).c_str());
+                j.Replay (n, to, [&](const RelayJournal::Event& e, const std::vector<char>&) {
+                    event_line (e);
+                });
+            }
+            else
+                throw DemoErr (FormatString("Unknown JOURNALQUERY query %s.", op.c_str()));
+        }
+    }
+    catch (...) {
+        fclose (f);
+        throw;
+    }
+    fclose (f);
+}
+
+/* (PANELIMAGE "file" {scale}) writes a PNG of the whole panel, at scale
+   (default 1) whatever the window is showing. */
+static void DemoPanelImage (Sexpr S) {
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing file name in PANELIMAGE.");
+    std::string path = State->ExpandPath(CAR(S).u.s);
+    double scale = 1.0;
+    if (CDR(S).type == Lisp::tCONS) {
+        if (!NUMBERP(CADR(S)))
+            throw DemoErr ("PANELIMAGE scale not a number.");
+        scale = *LCoerceToFloat(CADR(S)).u.f;
+    }
+    if (!WritePanelImage (path.c_str(), scale))
+        throw DemoErr (std::string("Cannot write panel image ") + path);
+}
+
+/* (RELAYPLOT "file" {"title"}) draws every relay circuit, and the index, to
+   an SVG file. */
+static void DemoRelayPlot (Sexpr S) {
+    if (S.type != Lisp::tCONS || CAR(S).type != Lisp::STRING)
+        throw DemoErr ("Missing file name in RELAYPLOT.");
+    std::string path = State->ExpandPath(CAR(S).u.s);
+    std::string title = CAR(S).u.s;
+    if (CDR(S).type == Lisp::tCONS) {
+        if (CADR(S).type != Lisp::STRING)
+            throw DemoErr ("RELAYPLOT title not a string.");
+        title = CADR(S).u.s;
+    }
+    if (!PlotInterlocking (path.c_str(), title.c_str()))
+        throw DemoErr ("Relay plot failed.");
+}
+
 /* this is an external API  -- see demoapi.h*/
 void DemoPause (int haltsw) {
 #ifdef NXOLE
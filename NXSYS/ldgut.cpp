@@ -8,8 +8,13 @@ class Relay;
 #include "RLYINDEX.H"
 #include "compat32.h"
 #include "PolyKludge.h"
+#include "SVGPlot.hpp"
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
 
 extern LNode ONE;
 extern LNode ZERO;
@@ -51,14 +56,32 @@ static int LDrawFlags = 0;
 
 class GNode;
 
+/* A relay's circuit, laid out, is kept until the interlocking is reloaded or
+   the page changes size, and shared by every drawing of it; laying out is
+   most of the cost of drawing a relay.  Those of its nodes that show a
+   relay's state are listed, so that a change of state can be shown without
+   redrawing everything. */
+struct CircuitLayout {
+    LNode * exp;
+    std::unique_ptr<GNode> root;
+    std::vector<char> marks;		/* its Darray, made by Drawing::Mark */
+    short miny, maxy, maxx;
+    std::vector<GNode*> bound;
+};
+
+static std::map<std::pair<Relay*, int>, std::shared_ptr<CircuitLayout>> Layouts;
+
 class Drawing {
 public:
     Scord x, y;
     int  xcord, ycord;
     GNode* root;
+    std::shared_ptr<CircuitLayout> layout;
+    std::vector<char> shown;		/* states of layout->bound, as last shown */
     short miny, maxy, maxx;
     Relay * relay;
     int    yorg;
+    char * marks;
     void   Mark (short xg, short yg);
     void   PlaceOnPage();
 };
@@ -68,14 +91,21 @@ std::vector<Drawing*> Drawings;
 char * Darray = NULL;
 char * Parray = NULL;
 
+static int PageWidth, PageHeight, PageCanonM;
+
 const GNode* LocateRelayFromXY (int x, int y);
 
 void DrawingSetPageSize (int width, int height, int canonm, int flags) {
-    LDrawFlags = flags;
+    PageWidth = width;
+    PageHeight = height;
+    PageCanonM = canonm;
     int new_cellw = canonm/(ContactsPerLine + 1);
     int new_cellh = (new_cellw*2)/5;
     int new_ncellw = width/new_cellw - 1;
     int new_ncellh = height/new_cellh - 2;
+    if (new_ncellw != NCellW || 2*new_ncellh != DNCellH || flags != LDrawFlags)
+	Layouts.clear();
+    LDrawFlags = flags;
     if (Parray != NULL) {
 	char * new_Parray = new char [new_ncellw * new_ncellh];
 	memset (new_Parray, 0, new_ncellw*new_ncellh);
@@ -98,6 +128,15 @@ void DrawingSetPageSize (int width, int height, int canonm, int flags) {
 	d->PlaceOnPage();
 }
 
+/* As last set, for whoever borrows the page to put it back; all zero if it
+   never was. */
+void DrawingGetPageSize (int& width, int& height, int& canonm, int& flags) {
+    width = PageWidth;
+    height = PageHeight;
+    canonm = PageCanonM;
+    flags = LDrawFlags;
+}
+
 
 class GNode {
 public:
@@ -115,15 +154,18 @@ public:
     void Thread (GNode * parent);
     void Layout (int xcell, int ycell, Drawing &);
     void Flatten();
-    void Draw (HDC dc, Drawing& D);
-    void CTriangle (HDC dc, Scord x, Scord y);
-    void CDot (HDC dc, Scord x, Scord y);
-    void DrawCoil(HDC dc, Scord x, Scord y, int tmrp);
-    void DrawContactLabel(HDC dc, Scord x, Scord y);
-    void DrawBaseLine(HDC dc, Scord x, Scord y, Drawing & D);
-    void DrawStickContact(HDC dc, Scord x, Scord y, Drawing& D);
+    /* On a window's or printer's HDC, or an SVGPlot. */
+    template <class DC> void Draw (DC dc, Drawing& D);
+    template <class DC> void CTriangle (DC dc, Scord x, Scord y);
+    template <class DC> void CDot (DC dc, Scord x, Scord y);
+    template <class DC> void DrawCoil(DC dc, Scord x, Scord y, int tmrp);
+    template <class DC> void DrawContactLabel(DC dc, Scord x, Scord y);
+    template <class DC> void DrawBaseLine(DC dc, Scord x, Scord y, Drawing & D);
+    template <class DC> void DrawStickContact(DC dc, Scord x, Scord y, Drawing& D);
+    void Bind (std::vector<GNode*>& bound);
+    RECT StateRect (const Drawing& D) const;
     int Dotoc (short gx, short gy);
-    void BXHookCell (HDC dc, Scord scx, Scord scy);
+    template <class DC> void BXHookCell (DC dc, Scord scx, Scord scy);
     BOOL Lastp ();
     bool IsThisMeXY(int x, int y, const Drawing& d) const;
     const GNode* LocateRelayRecurse(int x, int y, const Drawing& drawing) const;
@@ -270,46 +312,141 @@ static GNode * G = NULL;
 static Drawing* DD = NULL;
 
 
-void DrawCircuit (LNode * ln, LNode* exp, int tmr){
-
-    if (Darray == NULL)
-	Darray = new char [DNCellH*NCellW];
-    GNode* pRoot = new GNode;
-    if (pRoot == NULL)
-raf:	FatalAppExit (0, "LDRAW root alloc fails.");
-    GNode& root = *pRoot;
+static std::shared_ptr<CircuitLayout> LayOutCircuit (Relay * r, LNode* exp, int tmr) {
+    auto layout = std::make_shared<CircuitLayout>();
+    layout->exp = exp;
+    layout->root.reset(new GNode);
+    GNode& root = *layout->root;
     root.type = CT_AND;
     GNode* pRelay = new GNode;
-	if (pRelay == NULL)
-	    goto raf;
     GNode& relay = *pRelay;
-    Relay * r = (Relay *) ln;
     relay.text = r->RelaySym.u.r->PRep().c_str();
 
     relay.type = tmr ? CT_COILTIMER : CT_COIL;
     relay.width = relay.height = 1;
     relay.Thread (&root);
     relay.Statep = &(r->State);
-    Drawing * D = new Drawing;
-    if (D == NULL)
-	goto raf;
-    D->yorg = DNCellH/2;
-    D->relay = r;
-    GNode * gn = CreateGNode (exp, pRoot, *D);
+    Drawing D;
+    D.yorg = DNCellH/2;
+    D.relay = r;
+    GNode * gn = CreateGNode (exp, &root, D);
     root.width = 1 + gn->width;
     root.height = gn->height;
     root.Flatten();
 
-    D->root = &root;
-    D->miny = 0;
-    D->maxx = 0;
-    D->maxy = 0;
-    memset (Darray, 0, DNCellH*NCellW);
-    root.Layout (0, 0, *D);
-    G = pRoot;
+    D.miny = 0;
+    D.maxx = 0;
+    D.maxy = 0;
+    layout->marks.assign (DNCellH*NCellW, 0);
+    D.marks = layout->marks.data();
+    root.Layout (0, 0, D);
+    layout->miny = D.miny;
+    layout->maxy = D.maxy;
+    layout->maxx = D.maxx;
+    root.Bind (layout->bound);
+    return layout;
+}
+
+void DrawCircuit (LNode * ln, LNode* exp, int tmr){
+
+    if (Darray == NULL)
+	Darray = new char [DNCellH*NCellW];
+    Relay * r = (Relay *) ln;
+    std::shared_ptr<CircuitLayout>& layout = Layouts[std::make_pair(r, tmr)];
+    if (!layout || layout->exp != exp)
+	layout = LayOutCircuit (r, exp, tmr);
+    memcpy (Darray, layout->marks.data(), layout->marks.size());
+
+    delete DD;				/* drawn but never placed */
+    Drawing * D = new Drawing;
+    D->layout = layout;
+    D->root = layout->root.get();
+    D->yorg = DNCellH/2;
+    D->relay = r;
+    D->miny = layout->miny;
+    D->maxy = layout->maxy;
+    D->maxx = layout->maxx;
+    G = D->root;
     DD = D;
 }
 
+/* Lays out many circuits at once, one to a core, into the cache, so that
+   drawing them after is only placing them.  Laying out changes nothing
+   but the layout it makes, and reads only the relays and the page. */
+void LayOutCircuits (const std::vector<RelayCircuit>& circuits) {
+    std::vector<const RelayCircuit*> todo;
+    for (auto& c : circuits) {
+	auto it = Layouts.find (std::make_pair(c.relay, c.timer));
+	if (it == Layouts.end() || it->second->exp != c.exp)
+	    todo.push_back(&c);
+    }
+    std::vector<std::shared_ptr<CircuitLayout>> done (todo.size());
+    std::atomic<size_t> next (0);
+    auto worker = [&] {
+	for (size_t i; (i = next++) < todo.size(); )
+	    done[i] = LayOutCircuit (todo[i]->relay, todo[i]->exp, todo[i]->timer);
+    };
+    size_t nthreads = std::thread::hardware_concurrency();
+    if (nthreads > todo.size())
+	nthreads = todo.size();
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nthreads; i++)
+	threads.emplace_back (worker);
+    worker();
+    for (auto& t : threads)
+	t.join();
+    for (size_t i = 0; i < todo.size(); i++)
+	Layouts[std::make_pair(todo[i]->relay, todo[i]->timer)] = done[i];
+}
+
+void GNode::Bind (std::vector<GNode*>& bound) {
+    switch (type) {
+	case CT_FRONT:
+	case CT_BACK:
+	    bound.push_back(this);
+	    break;
+	case CT_COIL:
+	case CT_COILTIMER:
+	    if (!(LDrawFlags & LDRAW_NO_STATEREPORT))
+		bound.push_back(this);
+	    break;
+	default:
+	    for (GNode * sn = Child; sn != NULL; sn = sn->Next)
+		sn->Bind (bound);
+	    break;
+    }
+}
+
+/* Where a node shows its relay's state: a contact's triangle, or the coil's
+   PICKED/DROPPED, both within its cell. */
+RECT GNode::StateRect (const Drawing& D) const {
+    RECT r;
+    if (stick) {
+	r.left = D.x;
+	r.top = D.y;
+	r.bottom = D.y + CellH;
+    }
+    else {
+	Scord scy = CellH*gridy + D.y;
+	r.left = CellW*gridx + D.x;
+	if (type == CT_COIL || type == CT_COILTIMER) {
+	    r.top = scy - CellH;
+	    r.bottom = scy;
+	}
+	else {
+	    r.left += xoff;
+	    r.top = scy - CellH/2;
+	    r.bottom = scy + CellH/2;
+	}
+    }
+    r.right = r.left + CellW;
+    r.left -= 2;
+    r.top -= 2;
+    r.right += 2;
+    r.bottom += 2;
+    return r;
+}
+
 void GNode::Layout (int xc, int yc, Drawing& D) {
     gridx = xc;
     gridy = yc;
@@ -398,7 +535,7 @@ nostick:        stick = 0;
     }
 }
 
-void GNode::CTriangle (HDC dc, Scord x, Scord y) {
+template <class DC> void GNode::CTriangle (DC dc, Scord x, Scord y) {
 	POINT point[3]{};
     Scord trx = x;
     Scord trb =  (Scord)(.1*CellW);
@@ -427,7 +564,7 @@ void GNode::CTriangle (HDC dc, Scord x, Scord y) {
 }
 
 
-void GNode::CDot (HDC dc, Scord x, Scord y) {
+template <class DC> void GNode::CDot (DC dc, Scord x, Scord y) {
     SelectObject (dc, GetStockObject (BLACK_BRUSH));
     Scord ix0 = x;
     Scord iy0 = y;
@@ -437,7 +574,7 @@ void GNode::CDot (HDC dc, Scord x, Scord y) {
 
 
 
-void GNode::DrawCoil (HDC dc, Scord scx, Scord scy, int timer_p) {
+template <class DC> void GNode::DrawCoil (DC dc, Scord scx, Scord scy, int timer_p) {
 	RECT txr{};
 	POINT point[3]{};
     short statereport = !(LDrawFlags & LDRAW_NO_STATEREPORT);
@@ -498,7 +635,7 @@ void GNode::DrawCoil (HDC dc, Scord scx, Scord scy, int timer_p) {
 }
 
 
-void GNode::DrawStickContact (HDC dc, Scord scx, Scord scy, Drawing& D) {
+template <class DC> void GNode::DrawStickContact (DC dc, Scord scx, Scord scy, Drawing& D) {
     Scord rscx = 0*CellW + D.x;
     Scord rscy = (Scord)(+.5*CellH+ D.y);
     MoveTo (dc, rscx, rscy);
@@ -526,7 +663,7 @@ void GNode::DrawStickContact (HDC dc, Scord scx, Scord scy, Drawing& D) {
 
 
 
-void GNode::BXHookCell (HDC dc, Scord scx, Scord scy) {
+template <class DC> void GNode::BXHookCell (DC dc, Scord scx, Scord scy) {
     Scord sex = (Scord)(scx + CellW*.80);
     LineTo (dc, sex, scy);
     Scord yh = (Scord)(CellW*.1);
@@ -536,7 +673,7 @@ void GNode::BXHookCell (HDC dc, Scord scx, Scord scy) {
     LineTo (dc, sex, scy);
 }
 
-void GNode::DrawBaseLine (HDC dc, Scord scx, Scord scy, Drawing & D) {
+template <class DC> void GNode::DrawBaseLine (DC dc, Scord scx, Scord scy, Drawing & D) {
     MoveTo (dc, scx, scy);
     Scord sex = scx + CellW;
      if (Lastp())
@@ -562,7 +699,7 @@ void GNode::DrawBaseLine (HDC dc, Scord scx, Scord scy, Drawing & D) {
     }	    
 }
 
-void GNode::DrawContactLabel (HDC dc, Scord scx, Scord scy) {
+template <class DC> void GNode::DrawContactLabel (DC dc, Scord scx, Scord scy) {
     
     int flgs = DT_TOP |DT_SINGLELINE|DT_NOCLIP; 
 	RECT txr{};
@@ -578,10 +715,12 @@ void GNode::DrawContactLabel (HDC dc, Scord scx, Scord scy) {
 	txr.right = (int)(scx + CellW*(.65+.2));
 	flgs |= DT_CENTER;
     }
+    BeginRelayLink (dc, text);
     DrawText (dc, text.c_str(), (int)text.size(), &txr, flgs);
+    EndLink (dc);
 }
 
-void GNode::Draw (HDC dc, Drawing& D) {
+template <class DC> void GNode::Draw (DC dc, Drawing& D) {
     Scord scx =  CellW*gridx + D.x;
     Scord scy = CellH*gridy + D.y;
     int lastp = Lastp();
@@ -771,6 +910,8 @@ got_it:
     d->xcord = x;
     d->ycord = y - (DD->miny-1);
     d->PlaceOnPage();
+    for (GNode * g : d->layout->bound)
+	d->shown.push_back(*g->Statep);
     Drawings.push_back(d);
     DD = NULL;
     LastDrawingX = d->x;
@@ -792,6 +933,31 @@ void RenderRelayPage (HDC dc) {
 	d->root->Draw(dc, *d);
 }
 
+/* Each drawing is the place its relay's name, wherever it is a contact,
+   links to. */
+void RenderRelayPage (SVGPlot * plot) {
+    for (auto d : Drawings) {
+	plot->Anchor (d->relay->RelaySym.u.r->PRep());
+	d->root->Draw(plot, *d);
+	plot->EndAnchor();
+    }
+}
+
+/* The places on the page where a relay has changed state since last asked,
+   so that only those need be painted again. */
+void ChangedRelayDrawingRects (std::vector<RECT>& rects) {
+    for (auto d : Drawings) {
+	std::vector<GNode*>& bound = d->layout->bound;
+	for (size_t i = 0; i < bound.size(); i++) {
+	    char state = *bound[i]->Statep;
+	    if (state != d->shown[i]) {
+		d->shown[i] = state;
+		rects.push_back(bound[i]->StateRect(*d));
+	    }
+	}
+    }
+}
+
 void RecordIndexDrawnRelays (int indexpage) {
     for (auto d : Drawings)
 	RecordRelayIndex (d->relay->RelaySym.u.r, indexpage);
@@ -817,9 +983,9 @@ GNode::~GNode () {
 void CleanUpDrawing () {
     ClearRelayGraphics();
     delete DD;
-    delete G;
     G = NULL;
     DD = NULL;
+    Layouts.clear();
     delete Parray;
     delete Darray;
     Parray = Darray = NULL;
@@ -922,16 +1088,13 @@ void Drawing::Mark (short xg, short yg) {
     int darray_index = xg+ (yg+yorg)*NCellW;
     /* Simply don't mark it if out of bounds */
     if (darray_index >= 0 && darray_index < NCellW*DNCellH)
-	Darray[darray_index] = 1;
+	marks[darray_index] = 1;
 }
 
 void ClearRelayGraphics() {
-    for (auto d : Drawings) {
-	if (G != d->root && d != DD) {
-	    delete d->root;
+    for (auto d : Drawings)
+	if (d != DD)
 	    delete d;
-	}
-    }
     Drawings.clear();
     delete Parray;
     Parray = NULL;
@@ -1,10 +1,28 @@
+#include <vector>
+
+class Relay;
+class LNode;
+class SVGPlot;
+
+/* A relay, and the circuit to draw for it: a timer's is its control's. */
+struct RelayCircuit {
+    Relay * relay;
+    LNode * exp;
+    int timer;
+};
+
 void DrawFile (const char *);
 void RenderRelays (HDC dc);
 void CleanUpDrawing();
 void DrawingSetPageSize (int width, int height, int canonm, int flags);
+void DrawingGetPageSize (int& width, int& height, int& canonm, int& flags);
+void DrawCircuit (LNode * relay, LNode * exp, int timer);
+void LayOutCircuits (const std::vector<RelayCircuit>& circuits);
 int RelayGraphicsMouse(WPARAM, WORD, WORD);
 int DrawRelayFromName (const char *);
 void RenderRelayPage (HDC dc);
+void RenderRelayPage (SVGPlot * plot);
+void ChangedRelayDrawingRects (std::vector<RECT>& rects);
 void RecordIndexDrawnRelays(int pageno);
 int PlaceRelayDrawing ();
 void ClearRelayGraphics();
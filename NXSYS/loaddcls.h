@@ -5,6 +5,7 @@
 
 extern std::string InterlockingName;
 extern char InterlockingLoaded, InterpretedP;
+extern long InterlockingLoadSerial;     /* counts loads, to tie snapshots to one */
 void DropAllSignals(), DropAllApproach(), ClearAllTrackSecs(),
       NormalAllSwitches(), ClearAllAuxLevers();
 void BobbleRGPs();
@@ -5,6 +5,8 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
+#include <algorithm>
+#include <cstdint>
 #include <cassert>
 #include "NXSYSMinMax.h"
 
@@ -35,7 +37,6 @@ static std::vector<GraphicObject*>AllObjects;
 static std::vector<GraphicObject*>VisibleObjects;
 #endif
 
-static std::unordered_map<unsigned int, std::vector<GraphicObject*>> Quads;
 
 
 static long VPSCWidth, VPSCHeight;
@@ -46,13 +47,434 @@ static GraphicObject *MouseUpObject = NULL;
 static WPRECT LRect = {0, 0, 0, 0};
 
 static void GetScrollSlops (WP_cord& xslop, WP_cord&yslop);
+static void FreeBackdrops ();
 
-int GraphicObjectCount() {
-    return (int)AllObjects.size();
+static void UnionLayoutRect (WP_cord x0, WP_cord y0, WP_cord x1, WP_cord y1) {
+    LRect.left = NXMIN(LRect.left, x0);
+    LRect.right = NXMAX(LRect.right, x1);
+    LRect.top = NXMIN(LRect.top, y0);
+    LRect.bottom = NXMAX(LRect.bottom, y1);
+}
+
+/* The rectangle every object is within, negative coordinates and all. */
+static WPRECT TrueLayoutExtent () {
+    WPRECT r = {0, 0, 0, 0};
+    bool first = true;
+    for (GraphicObject * g : AllObjects) {
+        WP_cord left = g->wp_x + g->wp_limits.left;
+        WP_cord right = g->wp_x + g->wp_limits.right;
+        WP_cord top = g->wp_y + g->wp_limits.top;
+        WP_cord bottom = g->wp_y + g->wp_limits.bottom;
+        if (first || left < r.left)
+            r.left = left;
+        if (first || right > r.right)
+            r.right = right;
+        if (first || top < r.top)
+            r.top = top;
+        if (first || bottom > r.bottom)
+            r.bottom = bottom;
+        first = false;
+    }
+    return r;
+}
+
+static WP_cord FloorDiv (WP_cord a, WP_cord b) {
+    return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+/* The mouse's own: a flat array of squares over the layout's extent, each
+   one cache line listing the mouse-sensitive objects touching it, in
+   display order, with more (rarely) to the side.  A hit is one index and
+   one line.  The squares are QUAD on a side unless the layout is so big
+   that that would take too much memory, and stay that size until the grid
+   is built again, which is only if something is placed outside it.  Rects
+   are padded by Pad so that a screen point's panel coordinates, which are
+   rounded, are in the square of every object it is in. */
+class HitGrid {
+public:
+    static const WP_cord Pad = 8;
+
+    bool Built () const {return !Cells.empty();}
+    void Build (const WPRECT& extent);
+    void Clear () {
+        Cells.clear();
+        Overflow.clear();
+        Serials.clear();
+    }
+    bool Covers (const WPRECT& r) const {
+        return FloorDiv(r.left - Pad, Size) >= I0 && FloorDiv(r.right + Pad, Size) < I0 + W
+            && FloorDiv(r.top - Pad, Size) >= J0 && FloorDiv(r.bottom + Pad, Size) < J0 + H;
+    }
+    void Insert (GraphicObject * g, unsigned long serial, const WPRECT& r);
+    void Remove (GraphicObject * g, const WPRECT& r);
+    GraphicObject * Hit (WP_cord x, WP_cord y, long scx, long scy) const;
+
+private:
+    struct alignas(64) Cell {
+        static const int Slots = (int)((64 - 2*sizeof(uint32_t)) / sizeof(GraphicObject*));
+        GraphicObject * G[Slots];
+        uint32_t N;                 /* of G in use */
+        uint32_t More;              /* 1 + index into Overflow, or 0 */
+    };
+    static const long MaxCells = 1L << 16;
+
+    WP_cord Size = QUAD, I0 = 0, J0 = 0;
+    long W = 0, H = 0;
+    std::vector<Cell> Cells;
+    std::vector<std::vector<GraphicObject*>> Overflow;
+    std::unordered_map<GraphicObject*, unsigned long> Serials;
+
+    long Column (WP_cord x) const {
+        return NXMAX(0L, NXMIN(W - 1, (long)(FloorDiv(x, Size) - I0)));
+    }
+    long Row (WP_cord y) const {
+        return NXMAX(0L, NXMIN(H - 1, (long)(FloorDiv(y, Size) - J0)));
+    }
+    template <class F> void ForCells (const WPRECT& r, F fn) {
+        for (long j = Row(r.top - Pad); j <= Row(r.bottom + Pad); j++)
+            for (long i = Column(r.left - Pad); i <= Column(r.right + Pad); i++)
+                fn(Cells[j*W + i]);
+    }
+    std::vector<GraphicObject*> Contents (const Cell& c) const;
+    void SetContents (Cell& c, const std::vector<GraphicObject*>& v);
+};
+
+void HitGrid::Build (const WPRECT& extent) {
+    Clear();
+    for (Size = QUAD; ; Size *= 2) {
+        I0 = FloorDiv(extent.left - Pad, Size);
+        J0 = FloorDiv(extent.top - Pad, Size);
+        W = (long)(FloorDiv(extent.right + Pad, Size) - I0 + 1);
+        H = (long)(FloorDiv(extent.bottom + Pad, Size) - J0 + 1);
+        if ((double)W * H <= MaxCells)
+            break;
+    }
+    Cells.resize((size_t)(W * H));
+}
+
+std::vector<GraphicObject*> HitGrid::Contents (const Cell& c) const {
+    std::vector<GraphicObject*> v (c.G, c.G + c.N);
+    if (c.More)
+        v.insert(v.end(), Overflow[c.More - 1].begin(), Overflow[c.More - 1].end());
+    return v;
+}
+
+void HitGrid::SetContents (Cell& c, const std::vector<GraphicObject*>& v) {
+    c.N = (uint32_t)NXMIN(v.size(), (size_t)Cell::Slots);
+    std::copy(v.begin(), v.begin() + c.N, c.G);
+    if (v.size() > c.N && !c.More) {
+        Overflow.emplace_back();
+        c.More = (uint32_t)Overflow.size();
+    }
+    if (c.More)
+        Overflow[c.More - 1].assign(v.begin() + c.N, v.end());
+}
+
+void HitGrid::Insert (GraphicObject * g, unsigned long serial, const WPRECT& r) {
+    Serials[g] = serial;
+    ForCells (r, [&](Cell& c) {
+        std::vector<GraphicObject*> v = Contents(c);
+        auto at = std::upper_bound(v.begin(), v.end(), serial,
+                                   [this](unsigned long s, GraphicObject * o) {return s < Serials[o];});
+        v.insert(at, g);
+        SetContents(c, v);
+    });
+}
+
+void HitGrid::Remove (GraphicObject * g, const WPRECT& r) {
+    if (!Serials.erase(g))
+        return;
+    ForCells (r, [&](Cell& c) {
+        std::vector<GraphicObject*> v = Contents(c);
+        v.erase(std::remove(v.begin(), v.end(), g), v.end());
+        SetContents(c, v);
+    });
+}
+
+GraphicObject * HitGrid::Hit (WP_cord x, WP_cord y, long scx, long scy) const {
+    const Cell& c = Cells[Row(y)*W + Column(x)];
+    for (uint32_t i = 0; i < c.N; i++)
+        if (c.G[i]->Visible && c.G[i]->HitP(scx, scy))
+            return c.G[i];
+    if (c.More)
+        for (GraphicObject * g : Overflow[c.More - 1])
+            if (g->Visible && g->HitP(scx, scy))
+                return g;
+    return NULL;
+}
+
+/* Where every object is, so that those in a rectangle -- the viewport, a
+   repaint, a mouse hit -- can be found without looking at all the others.
+   A uniform grid, hashed, as layouts are sparse; an object is in every cell
+   its rectangle touches.  An object's rectangle isn't known when it is
+   created, so it is placed at the next query; after that it is where it
+   was last placed, by MoveWP, ComputeVisibleLast (which follows every
+   change of shape in TLEdit) or ComputeVisibleObjects (all of them). */
+class GOGrid {
+public:
+    void Add (GraphicObject * g) {
+        Entry& e = Entries[g];
+        Unlink(e);
+        e = Entry{g, {0, 0, 0, 0}, NextSerial++, 0, false};
+        Pending.push_back(g);
+    }
+    void Place (GraphicObject * g);
+    void Remove (GraphicObject * g);
+    void Clear () {
+        Entries.clear();
+        Cells.clear();
+        Pending.clear();
+        Hits.Clear();
+    }
+    /* Those touching r, in order of creation, which is display order. */
+    void Query (const WPRECT& r, std::vector<GraphicObject*>& out);
+    /* The first mouse-sensitive object at screen x, y, panel px, py; the
+       hit grid is built at the first. */
+    GraphicObject * Hit (long x, long y, WP_cord px, WP_cord py);
+    unsigned long Serial (GraphicObject * g) {
+        auto it = Entries.find(g);
+        return (it == Entries.end()) ? 0 : it->second.Serial;
+    }
+
+private:
+    struct Entry {
+        GraphicObject * G;
+        WPRECT R;
+        unsigned long Serial;
+        unsigned long Stamp;        /* last query that saw it */
+        bool Placed;
+    };
+    static const WP_cord Cell = 64;
+    static WP_cord CellOf (WP_cord c) {    /* floor, for negatives too */
+        return (c >= 0) ? c / Cell : -((Cell - 1 - c) / Cell);
+    }
+    static uint64_t Key (WP_cord i, WP_cord j) {
+        return ((uint64_t)(uint32_t)i << 32) | (uint32_t)j;
+    }
+    void Link (Entry& e);
+    void Unlink (Entry& e);
+    void Flush () {
+        for (GraphicObject * g : Pending)
+            if (Entries.count(g) && !Entries[g].Placed)
+                Place(g);
+        Pending.clear();
+    }
+
+    std::unordered_map<GraphicObject*, Entry> Entries;   /* nodes don't move */
+    std::unordered_map<uint64_t, std::vector<Entry*>> Cells;
+    std::vector<GraphicObject*> Pending;
+    unsigned long NextSerial = 0;
+    unsigned long QueryStamp = 0;
+    HitGrid Hits;                   /* of the placed, once built */
+};
+
+void GOGrid::Link (Entry& e) {
+    for (WP_cord i = CellOf(e.R.left); i <= CellOf(e.R.right); i++)
+        for (WP_cord j = CellOf(e.R.top); j <= CellOf(e.R.bottom); j++)
+            Cells[Key(i, j)].push_back(&e);
+    e.Placed = true;
+    if (Hits.Built()) {
+        if (!Hits.Covers(e.R))
+            Hits.Clear();
+        else if (e.G->MouseSensitive())
+            Hits.Insert(e.G, e.Serial, e.R);
+    }
 }
 
-static inline unsigned int QuadKey (long i, long j) {
-    return (unsigned int)((i << 16) | j);
+void GOGrid::Unlink (Entry& e) {
+    if (!e.Placed)
+        return;
+    if (Hits.Built())
+        Hits.Remove(e.G, e.R);
+    for (WP_cord i = CellOf(e.R.left); i <= CellOf(e.R.right); i++)
+        for (WP_cord j = CellOf(e.R.top); j <= CellOf(e.R.bottom); j++) {
+            auto c = Cells.find(Key(i, j));
+            if (c == Cells.end())
+                continue;
+            auto& v = c->second;
+            auto it = std::find(v.begin(), v.end(), &e);
+            if (it != v.end()) {
+                *it = v.back();
+                v.pop_back();
+            }
+            if (v.empty())
+                Cells.erase(c);
+        }
+    e.Placed = false;
+}
+
+void GOGrid::Place (GraphicObject * g) {
+    auto it = Entries.find(g);
+    if (it == Entries.end())
+        return;
+    Entry& e = it->second;
+    WPRECT r;
+    r.left = g->wp_x + g->wp_limits.left;
+    r.right = g->wp_x + g->wp_limits.right;
+    r.top = g->wp_y + g->wp_limits.top;
+    r.bottom = g->wp_y + g->wp_limits.bottom;
+    UnionLayoutRect (r.left, r.top, r.right, r.bottom);
+    if (e.Placed && r.left == e.R.left && r.right == e.R.right
+        && r.top == e.R.top && r.bottom == e.R.bottom)
+        return;
+    Unlink(e);
+    e.R = r;
+    Link(e);
+}
+
+void GOGrid::Remove (GraphicObject * g) {
+    auto it = Entries.find(g);
+    if (it == Entries.end())
+        return;
+    Unlink(it->second);
+    Entries.erase(it);
+}
+
+void GOGrid::Query (const WPRECT& r, std::vector<GraphicObject*>& out) {
+    Flush();
+    std::vector<Entry*> found;
+    auto take = [&](Entry * e) {
+        if (e->Stamp != QueryStamp && e->Placed
+            && e->R.left <= r.right && e->R.right >= r.left
+            && e->R.top <= r.bottom && e->R.bottom >= r.top) {
+            e->Stamp = QueryStamp;
+            found.push_back(e);
+        }
+    };
+    QueryStamp++;
+    double ncells = double(CellOf(r.right) - CellOf(r.left) + 1)
+                  * double(CellOf(r.bottom) - CellOf(r.top) + 1);
+    if (ncells > Entries.size())        /* e.g., zoomed far out */
+        for (auto& pair : Entries)
+            take(&pair.second);
+    else
+        for (WP_cord i = CellOf(r.left); i <= CellOf(r.right); i++)
+            for (WP_cord j = CellOf(r.top); j <= CellOf(r.bottom); j++) {
+                auto c = Cells.find(Key(i, j));
+                if (c != Cells.end())
+                    for (Entry * e : c->second)
+                        take(e);
+            }
+    std::sort(found.begin(), found.end(),
+              [](Entry * a, Entry * b) {return a->Serial < b->Serial;});
+    out.clear();
+    for (Entry * e : found)
+        out.push_back(e->G);
+}
+
+GraphicObject * GOGrid::Hit (long x, long y, WP_cord px, WP_cord py) {
+    Flush();
+    if (!Hits.Built()) {
+        Hits.Build(TrueLayoutExtent());
+        std::vector<Entry*> placed;
+        for (auto& pair : Entries)
+            if (pair.second.Placed && pair.first->MouseSensitive())
+                placed.push_back(&pair.second);
+        std::sort(placed.begin(), placed.end(),
+                  [](Entry * a, Entry * b) {return a->Serial < b->Serial;});
+        for (Entry * e : placed)
+            Hits.Insert(e->G, e->Serial, e->R);
+    }
+    return Hits.Hit(px, py, x, y);
+}
+
+static GOGrid Grid;
+
+/* Objects by type, in order of creation, and by type and nomenclature.  An
+   object's type can't be asked in the base constructor, so new objects are
+   sorted into their types at the next question.  Nomenclature is known only
+   to the objects themselves (IsNomenclature), and can change as TLEdit
+   edits, so the nomenclature index is of answers found, each checked again
+   before it is given. */
+class GOTypeRegistry {
+public:
+    void Add (GraphicObject * g) {
+        Pending.push_back(g);
+    }
+    void Remove (GraphicObject * g);
+    void Clear () {
+        ByType.clear();
+        TypeOf.clear();
+        Pending.clear();
+        ByNom.clear();
+    }
+    std::vector<GraphicObject*>& OfType (TypeId type) {
+        Flush();
+        return Slot(type);
+    }
+    GraphicObject * FindByNom (long nomenclature, TypeId type);
+
+private:
+    std::vector<GraphicObject*>& Slot (TypeId type) {
+        return ByType[(int)type];
+    }
+    void Flush () {
+        for (GraphicObject * g : Pending) {
+            TypeId type = g->TypeID();
+            TypeOf[g] = type;
+            Slot(type).push_back(g);
+        }
+        Pending.clear();
+    }
+
+    std::unordered_map<int, std::vector<GraphicObject*>> ByType;  /* nodes don't move */
+    std::unordered_map<GraphicObject*, TypeId> TypeOf;
+    std::vector<GraphicObject*> Pending;
+    std::unordered_map<uint64_t, GraphicObject*> ByNom;
+};
+
+void GOTypeRegistry::Remove (GraphicObject * g) {
+    auto p = std::find(Pending.begin(), Pending.end(), g);
+    if (p != Pending.end()) {
+        Pending.erase(p);
+        return;
+    }
+    auto it = TypeOf.find(g);
+    if (it == TypeOf.end())
+        return;
+    auto& v = Slot(it->second);
+    v.erase(std::find(v.begin(), v.end(), g));
+    TypeOf.erase(it);
+    ByNom.clear();
+}
+
+GraphicObject * GOTypeRegistry::FindByNom (long nomenclature, TypeId type) {
+    uint64_t key = ((uint64_t)(uint32_t)(int)type << 32) | (uint32_t)nomenclature;
+    auto it = ByNom.find(key);
+    if (it != ByNom.end()) {
+        if (it->second->IsNomenclature(nomenclature))
+            return it->second;
+        ByNom.erase(it);
+    }
+    for (GraphicObject * g : OfType(type))
+        if (g->IsNomenclature(nomenclature))
+            return ByNom[key] = g;
+    return NULL;
+}
+
+static GOTypeRegistry Registry;
+
+/* A screen rectangle, as panel coordinates, a little generously, as those
+   are coarser when zoomed in; callers then test sc_limits. */
+static WPRECT SCRectToWP (const RECT& r) {
+    WP_cord slop = ScaleDen / NXMAX(ScaleNum, 1L) + 1;
+    WPRECT w;
+    w.left = SCXtoWP((SC_cord)r.left) - slop;
+    w.right = SCXtoWP((SC_cord)r.right) + slop;
+    w.top = SCYtoWP((SC_cord)r.top) - slop;
+    w.bottom = SCYtoWP((SC_cord)r.bottom) + slop;
+    return w;
+}
+
+static WPRECT SCPointToWP (long x, long y) {
+    RECT r;
+    r.left = r.right = (int)x;
+    r.top = r.bottom = (int)y;
+    return SCRectToWP(r);
+}
+
+int GraphicObjectCount() {
+    return (int)AllObjects.size();
 }
 
 BOOL GraphicObject::ComputeVisible (WPRECT& view) {
@@ -90,8 +512,73 @@ BOOL GraphicObject::HitP (long x,  long y) {
 	    && y < sc_limits.bottom;
 }
 
+/* Within a batch (e.g., a whole relay propagation, or everything a coder
+   blip flashed), invalidations are collected, and merged as they come
+   wherever a merged rectangle is no bigger than the two apart, so that an
+   object changed many times, or a row of them, costs one.  At the end the
+   few left are invalidated, and the system makes one paint of them all. */
+static int InvalidationBatchDepth = 0;
+static std::vector<RECT> DirtyRects;
+static const size_t MaxDirtyRects = 16;
+
+static long long RectArea (const RECT& r) {
+    return (long long)(r.right - r.left) * (r.bottom - r.top);
+}
+
+static RECT RectUnion (const RECT& a, const RECT& b) {
+    RECT u;
+    u.left = NXMIN(a.left, b.left);
+    u.top = NXMIN(a.top, b.top);
+    u.right = NXMAX(a.right, b.right);
+    u.bottom = NXMAX(a.bottom, b.bottom);
+    return u;
+}
+
+static void AddDirtyRect (const RECT& r) {
+    for (RECT& d : DirtyRects)
+        if (RectArea(RectUnion(d, r)) <= RectArea(d) + RectArea(r)) {
+            d = RectUnion(d, r);
+            return;
+        }
+    DirtyRects.push_back(r);
+    if (DirtyRects.size() <= MaxDirtyRects)
+        return;
+    /* Too many: merge the two that waste least. */
+    size_t bi = 0, bj = 1;
+    long long best = -1;
+    for (size_t i = 0; i < DirtyRects.size(); i++)
+        for (size_t j = i + 1; j < DirtyRects.size(); j++) {
+            long long waste = RectArea(RectUnion(DirtyRects[i], DirtyRects[j]))
+                            - RectArea(DirtyRects[i]) - RectArea(DirtyRects[j]);
+            if (best < 0 || waste < best) {
+                best = waste;
+                bi = i;
+                bj = j;
+            }
+        }
+    DirtyRects[bi] = RectUnion(DirtyRects[bi], DirtyRects[bj]);
+    DirtyRects.erase(DirtyRects.begin() + bj);
+}
+
+void BeginInvalidationBatch () {
+    InvalidationBatchDepth++;
+}
+
+void EndInvalidationBatch () {
+    if (--InvalidationBatchDepth > 0)
+        return;
+    for (RECT& r : DirtyRects)
+        InvalidateRect (G_mainwindow, &r, INVALIDATE_CLEAR_BKGD);
+    DirtyRects.clear();
+}
+
+/* In a batch, an object off the screen isn't invalidated; its sc_limits
+   are of wherever it was last seen. */
 void GraphicObject::Invalidate () {
-    InvalidateRect (G_mainwindow, &sc_limits, INVALIDATE_CLEAR_BKGD);
+    if (InvalidationBatchDepth == 0)
+        InvalidateRect (G_mainwindow, &sc_limits, INVALIDATE_CLEAR_BKGD);
+    else if (Visible)
+        AddDirtyRect (sc_limits);
 }
 
 
@@ -108,56 +595,36 @@ void GraphicObject::UnHide (){
 }
 
 
-void GraphicObject::ContributeToLayoutRect() {
-    WP_cord x0 = wp_x + wp_limits.left;
-    WP_cord x1 = wp_x + wp_limits.right;
-    WP_cord y0 = wp_y + wp_limits.top;
-    WP_cord y1 = wp_y + wp_limits.bottom;
-    LRect.left = NXMIN(LRect.left, x0);
-    LRect.right = NXMAX(LRect.right, x1);
-    LRect.top = NXMIN(LRect.top, y0);
-    LRect.bottom = NXMAX(LRect.bottom, y1);
-    // New lookup system 9/2/2019, RealNXSYS only - TLEdit moves, creates, and deletes objects.
-#if ! TLEDIT
-    if (MouseSensitive())
-        for (WP_cord i = x0/QUAD; i <= (x1 + 1)/QUAD; i++)
-            for (WP_cord j = y0/QUAD; j <= (y1 + 1)/QUAD; j++)
-                Quads[QuadKey(i, j)].push_back(this);
+/* The viewport has moved or changed size, but nothing else has: only the
+   objects in it (and those that were) need be looked at. */
+static void ComputeVisibleObjectsInView () {
+    for (GraphicObject * go : VisibleObjects)
+        go->Visible = FALSE;
+    VisibleObjects.clear();
+#ifdef NXSYSMac
+    /* Everything is "visible" here (see ComputeVisible). */
+    for (GraphicObject *go : AllObjects)
+        if (go->ComputeVisible (Viewport))
+            go->UnHide();
+#else
+    std::vector<GraphicObject*> in_view;
+    Grid.Query (Viewport, in_view);
+    for (GraphicObject *go : in_view)
+        if (go->ComputeVisible (Viewport))
+            go->UnHide();
 #endif
 }
 
+/* Everything, including the layout's extent (Place adds each object's to
+   it) and every object's place. */
 void ComputeVisibleObjects (WPRECT& view) {
     Viewport = view;
-    VisibleObjects.clear();
     LRect.top = LRect.left = LRect.bottom = LRect.right = 0;
-    for (GraphicObject *go : AllObjects) {
-        go->ContributeToLayoutRect();
-        if (go->ComputeVisible (view))
-            go->UnHide();
-        else go->Visible = FALSE;
-    }
+    for (GraphicObject *go : AllObjects)
+        Grid.Place(go);
+    FreeBackdrops();
+    ComputeVisibleObjectsInView();
     NXGO_SetScrollPosition(G_mainwindow);
-
-#if REPORT_QUADMAP_DISTRIBUTION
-    if (Quads.empty())  // happens during initialization
-        return;
-    std::map<size_t, int> M;    //ordered map.
-    for (auto& pair : Quads) {
-        size_t len = pair.second.size();
-        if (M.count(len))
-            M[len] += 1;
-        else
-            M[len] = 1;
-    }
-    int sensitive = 0;
-    for (auto obj : AllObjects)
-        if (obj->MouseSensitive())
-            sensitive += 1;
-    for (auto& e : M)
-        printf("%2ld: %2d\n", e.first, e.second);
-    printf("%ld nonempty quads, %ld graphical objects, %d sensitive.\n",
-           Quads.size(), AllObjects.size(), sensitive);
-#endif
 }
 
 WP_cord SCXtoWP (SC_cord x) {
@@ -182,6 +649,7 @@ void ComputeVisibleObjectsLast() {
 }
 
 void GraphicObject::ComputeVisibleLast() {
+    Grid.Place(this);
     ComputeVisible(Viewport);
 }
 
@@ -202,28 +670,222 @@ void DisplayVisibleObjects (HDC dc) {
         objp->Display(dc);
 }
 
-void DisplayVisibleObjectsRect (HDC dc, RECT &ur) {
-    for (GraphicObject * g : VisibleObjects) {
-        if (ur.left > g->sc_limits.right)
-            continue;
-        if (ur.right < g->sc_limits.left)
-            continue;
-        if (ur.top > g->sc_limits.bottom)
-            continue;
-        if (ur.bottom < g->sc_limits.top)
+/* Those of objs as the window would show them with view at num/den, each
+   by draw; their screen places and visibility are put back after, and
+   their panel extents, which text resized to the scale (TextString's
+   ScaleSelf) changes, and which it redoes at the window's next paint. */
+template <class Draw>
+static void DisplayObjectsAs (const std::vector<GraphicObject*>& objs, const WPRECT& view,
+                              long num, long den, Draw draw) {
+    struct Saved {
+        RECT wp_limits, sc_limits;
+        SC_cord sc_x, sc_y;
+        short Visible;
+    };
+    WPRECT save_viewport = Viewport;
+    long save_num = ScaleNum, save_den = ScaleDen;
+    double save_scale = NXGO_Scale;
+    Viewport = view;
+    ScaleNum = num;
+    ScaleDen = den;
+    NXGO_Scale = num/(double)den;
+    std::vector<Saved> saved;
+    saved.reserve(objs.size());
+    for (GraphicObject * g : objs) {
+        saved.push_back(Saved{g->wp_limits, g->sc_limits, g->sc_x, g->sc_y, g->Visible});
+        if (g->ComputeVisible (Viewport))
+            draw(g);
+    }
+    Viewport = save_viewport;
+    ScaleNum = save_num;
+    ScaleDen = save_den;
+    NXGO_Scale = save_scale;
+    for (size_t i = 0; i < objs.size(); i++) {
+        objs[i]->wp_limits = saved[i].wp_limits;
+        objs[i]->sc_limits = saved[i].sc_limits;
+        objs[i]->sc_x = saved[i].sc_x;
+        objs[i]->sc_y = saved[i].sc_y;
+        objs[i]->Visible = saved[i].Visible;
+    }
+}
+
+/* Zoomed out, a big layout is mostly track, the same at every paint, and
+   text too small to read.  The track is drawn once per scale into a bitmap
+   of the whole layout (its "backdrop"), copied in wherever the window is
+   painted; over it is drawn only what the track shows -- occupancy and
+   routing -- and the signals' aspects. */
+static const int MinTextPixels = 12;            /* about the panel font at .8 */
+
+bool NXGO_Overview () {
+#if TLEDIT
+    return false;                               /* the track is being edited */
+#else
+    return 2*ScaleNum < ScaleDen;
+#endif
+}
+
+/* Whether text height high on the panel is big enough to read on screen. */
+bool NXGO_TextLegible (WP_cord height) {
+    return height*ScaleNum >= MinTextPixels*ScaleDen;
+}
+
+void GraphicObject::DisplayOverview (HDC dc, OverviewLayer layer) {}
+
+#ifndef NXSYSMac
+struct Backdrop {
+    long Num, Den;
+    WPRECT Extent;
+    int Width, Height;
+    HBITMAP Bitmap;                             /* NULL if too big to have */
+};
+static std::vector<Backdrop> Backdrops;         /* the one last used last */
+static const size_t BackdropsKept = 2;          /* this scale and the one before */
+static const long long MaxBackdropPixels = 1LL << 23;
+
+static void FreeBackdrops () {
+    for (Backdrop& b : Backdrops)
+        if (b.Bitmap)
+            DeleteObject (b.Bitmap);
+    Backdrops.clear();
+}
+
+/* This scale's backdrop, drawn if need be; NULL if the layout is too big
+   at this scale to keep one. */
+static Backdrop * GetBackdrop (HDC dc) {
+    for (size_t i = 0; i < Backdrops.size(); i++)
+        if (Backdrops[i].Num == ScaleNum && Backdrops[i].Den == ScaleDen) {
+            std::rotate(Backdrops.begin() + i, Backdrops.begin() + i + 1, Backdrops.end());
+            return Backdrops.back().Bitmap ? &Backdrops.back() : NULL;
+        }
+    Backdrop b;
+    b.Num = ScaleNum;
+    b.Den = ScaleDen;
+    b.Extent = TrueLayoutExtent();
+    b.Width = (int)(((b.Extent.right - b.Extent.left)*ScaleNum)/ScaleDen) + 1;
+    b.Height = (int)(((b.Extent.bottom - b.Extent.top)*ScaleNum)/ScaleDen) + 1;
+    b.Bitmap = NULL;
+    if ((long long)b.Width*b.Height <= MaxBackdropPixels)
+        b.Bitmap = CreateCompatibleBitmap (dc, b.Width, b.Height);
+    if (b.Bitmap) {
+        HDC mem = CreateCompatibleDC (dc);
+        HGDIOBJ old = SelectObject (mem, b.Bitmap);
+        PatBlt (mem, 0, 0, b.Width, b.Height, BLACKNESS);
+        SelectObject (mem, Fnt);
+        SetBkColor (mem, RGB(0, 0, 0));
+        SetTextColor (mem, RGB(255, 255, 255));
+        std::vector<GraphicObject*> all;
+        Grid.Query (b.Extent, all);
+        DisplayObjectsAs (all, b.Extent, ScaleNum, ScaleDen,
+                          [mem](GraphicObject * g) {g->DisplayOverview(mem, OverviewLayer::Track);});
+        SelectObject (mem, old);
+        DeleteDC (mem);
+    }
+    if (Backdrops.size() >= BackdropsKept) {
+        if (Backdrops.front().Bitmap)
+            DeleteObject (Backdrops.front().Bitmap);
+        Backdrops.erase(Backdrops.begin());
+    }
+    Backdrops.push_back(b);
+    return b.Bitmap ? &Backdrops.back() : NULL;
+}
+#else
+static void FreeBackdrops () {}
+#endif
+
+/* The rectangles, zoomed out, with the objects in them.  Drawn over the
+   backdrop, they are placed as it was drawn, from the layout's corner, and
+   the whole shifted to the window, which may put them a pixel from where
+   the window's own arithmetic has them (which the mouse's slop covers). */
+static void DisplayOverviewRects (HDC dc, const RECT * rects, int n,
+                                  const std::vector<GraphicObject*>& objs) {
+#ifndef NXSYSMac
+    if (Backdrop * b = GetBackdrop (dc)) {
+        int xoff = (int)(((Viewport.left - b->Extent.left)*ScaleNum)/ScaleDen);
+        int yoff = (int)(((Viewport.top - b->Extent.top)*ScaleNum)/ScaleDen);
+        HDC mem = CreateCompatibleDC (dc);
+        HGDIOBJ old = SelectObject (mem, b->Bitmap);
+        for (int i = 0; i < n; i++) {
+            const RECT& r = rects[i];
+            PatBlt (dc, r.left, r.top, r.right - r.left, r.bottom - r.top, BLACKNESS);
+            BitBlt (dc, r.left, r.top, r.right - r.left, r.bottom - r.top,
+                    mem, r.left + xoff, r.top + yoff, SRCCOPY);
+        }
+        SelectObject (mem, old);
+        DeleteDC (mem);
+        POINT org;
+        SetViewportOrgEx (dc, -xoff, -yoff, &org);
+        DisplayObjectsAs (objs, b->Extent, ScaleNum, ScaleDen,
+                          [dc](GraphicObject * g) {g->DisplayOverview(dc, OverviewLayer::Indications);});
+        SetViewportOrgEx (dc, org.x, org.y, NULL);
+        return;
+    }
+#endif
+    for (int i = 0; i < n; i++) {
+        RECT r = rects[i];
+        FillRect (dc, &r, (HBRUSH)GetStockObject (BLACK_BRUSH));
+    }
+    for (GraphicObject * g : objs)
+        g->DisplayOverview(dc, OverviewLayer::Track);
+    for (GraphicObject * g : objs)
+        g->DisplayOverview(dc, OverviewLayer::Indications);
+}
+
+/* A paint of several separate rectangles: each object in any of them is
+   displayed once, in order. */
+void DisplayVisibleObjectsRects (HDC dc, const RECT * rects, int n) {
+    std::vector<GraphicObject*> in_rects, in_rect, drawn;
+    for (int i = 0; i < n; i++) {
+        Grid.Query (SCRectToWP(rects[i]), in_rect);
+        in_rects.insert(in_rects.end(), in_rect.begin(), in_rect.end());
+    }
+    if (n > 1) {
+        std::sort(in_rects.begin(), in_rects.end(),
+                  [](GraphicObject * a, GraphicObject * b) {return Grid.Serial(a) < Grid.Serial(b);});
+        in_rects.erase(std::unique(in_rects.begin(), in_rects.end()), in_rects.end());
+    }
+    for (GraphicObject * g : in_rects) {
+        if (!g->Visible)
             continue;
-        g->Display(dc);
+        for (int i = 0; i < n; i++)
+            if (rects[i].left <= g->sc_limits.right && rects[i].right >= g->sc_limits.left
+                && rects[i].top <= g->sc_limits.bottom && rects[i].bottom >= g->sc_limits.top) {
+                drawn.push_back(g);
+                break;
+            }
     }
+    if (NXGO_Overview())
+        DisplayOverviewRects (dc, rects, n, drawn);
+    else
+        for (GraphicObject * g : drawn)
+            g->Display(dc);
+}
+
+void DisplayVisibleObjectsRect (HDC dc, RECT &ur) {
+    DisplayVisibleObjectsRects (dc, &ur, 1);
+}
+
+/* Everything in view, at scale, onto dc, as if the window showed that, but
+   leaving the window's own view alone: for images of the panel made off the
+   screen. */
+void NXGO_DisplayLayout (HDC dc, const WPRECT& view, double scale) {
+    std::vector<GraphicObject*> in_view;
+    Grid.Query (view, in_view);
+    DisplayObjectsAs (in_view, view, (long)(scale*100.0), 100,
+                      [dc](GraphicObject * g) {g->Display(dc);});
 }
 
 GraphicObject::GraphicObject () {
     Selected = FALSE;
     Visible = FALSE;
+    wp_x = wp_y = 0;
+    wp_limits.left = wp_limits.right = wp_limits.top = wp_limits.bottom = 0;
 #if TLEDIT
     AllObjects.insert(this);
 #else
     AllObjects.push_back(this);
 #endif
+    Grid.Add(this);
+    Registry.Add(this);
 }
 
 void GraphicObject::Consume() {
@@ -249,19 +911,18 @@ TypeId GraphicObject::TypeID() {
     return TypeId::NONE;
 }
 
+/* TLEdit, which moves, creates and deletes objects all the time, and NXSYS
+   zoomed out so far that a pixel is more than the hit grid's padding, look
+   in the general grid. */
 GraphicObject * GetMouseHitObject (WORD x, WORD y) {
-    if (Quads.size()) {
-        auto key = QuadKey(SCXtoWP(x)/QUAD, SCYtoWP(y)/QUAD);
-        if (Quads.count(key)) {
-            for (GraphicObject* g : Quads[key]) {
-                if (g->HitP(x, y))  // only Mouse-sensitive objects are in Quads.
-                    return g;
-            }
-        }
-        return NULL;
-    }
-    for (auto objp : VisibleObjects)
-        if (objp->MouseSensitive() && objp->HitP(x, y))
+#if ! TLEDIT
+    if (ScaleDen / NXMAX(ScaleNum, 1L) + 1 <= HitGrid::Pad)
+        return Grid.Hit (x, y, SCXtoWP(x), SCYtoWP(y));
+#endif
+    std::vector<GraphicObject*> near;
+    Grid.Query (SCPointToWP(x, y), near);
+    for (auto objp : near)
+        if (objp->Visible && objp->MouseSensitive() && objp->HitP(x, y))
             return objp;
     return NULL;
 }
@@ -295,19 +956,20 @@ GraphicObject * MapAllVisibleGraphicObjects (GOGOMapperFcn fn, void * arg) {
     return NULL;
 }
 
+/* By index, as mappers may create objects (of any type). */
 int MapGraphicObjectsOfType (TypeId type, GOMapperFcn fn) {
-    for (GraphicObject * g : AllObjects)
-        if (g->TypeID() == type)
-	    if (fn (g))
-		return 1;
+    std::vector<GraphicObject*>& of_type = Registry.OfType(type);
+    for (size_t i = 0; i < of_type.size(); i++)
+        if (fn (of_type[i]))
+            return 1;
     return 0;
 }
 
 GraphicObject* MapFindGraphicObjectsOfType (TypeId type, GOGOMapperFcn fn, void* arg) {
-       for (GraphicObject * g : AllObjects)
-           if (g->TypeID() == type)
-               if (fn (g, arg))
-                   return g;
+    std::vector<GraphicObject*>& of_type = Registry.OfType(type);
+    for (size_t i = 0; i < of_type.size(); i++)
+        if (fn (of_type[i], arg))
+            return of_type[i];
     return NULL;
 }
 
@@ -348,7 +1010,7 @@ void GraphicObject::MoveWP (WP_cord x, WP_cord y) {
     wp_x = x;
     wp_y = y;
     ComputeWPRect();
-    /* this has  to be done more efficiently  +++++++++++++++++*/
+    Grid.Place(this);
     ComputeVisible (Viewport);
     if (wasv)
 	UnHide();
@@ -368,6 +1030,8 @@ void GraphicObject::AfterResurrection() {
 #else
     AllObjects.push_back(this);
 #endif
+    Grid.Add(this);
+    Registry.Add(this);
 }
 
 static void Deselect0() {
@@ -387,6 +1051,10 @@ void GraphicObject::BeforeInterment() {
 	Deselect0();
     if (this == MouseUpObject)
 	MouseUpObject = NULL;
+    if (!NXGODeleteAll) {
+        Grid.Remove(this);
+        Registry.Remove(this);
+    }
 #if TLEDIT
     if (!NXGODeleteAll) {
         Hide();
@@ -397,7 +1065,9 @@ void GraphicObject::BeforeInterment() {
 }
 
 void FreeGraphicObjects () {
-    Quads.clear();
+    FreeBackdrops();
+    Grid.Clear();
+    Registry.Clear();
     SelectedObject = NULL;
     MouseUpObject = NULL;
     NXGODeleteAll = TRUE;
@@ -414,8 +1084,15 @@ WPPOINT GraphicObject::WPPoint() {
     return WPPOINT(wp_x, wp_y);
 }
 
+/* An object's point is within its rectangle, so is nearly always found in
+   the grid; but one not placed since its shape changed would be missed. */
 GraphicObject * FindObjectByTypeAndWPpos(TypeId type, WP_cord wp_x, WP_cord wp_y) {
     WPPOINT P(wp_x, wp_y);
+    std::vector<GraphicObject*> near;
+    Grid.Query (WPRECT{wp_y, wp_y, wp_x, wp_x}, near);
+    for (GraphicObject * g : near)
+        if (g->TypeID() == type && P == g->WPPoint())
+            return g;
     for (GraphicObject * g : AllObjects) {
         if (g->TypeID() == type)
             if (P == g->WPPoint())
@@ -425,18 +1102,15 @@ GraphicObject * FindObjectByTypeAndWPpos(TypeId type, WP_cord wp_x, WP_cord wp_y
 }
 
 GraphicObject * FindObjectByNomAndType (long nomenclature, TypeId type) {
-    for (GraphicObject * g : AllObjects) {
-	if (g->TypeID() == type)
-	    if (g->IsNomenclature (nomenclature))
-		return g;
-    }
-    return NULL;
+    return Registry.FindByNom (nomenclature, type);
 }
 
 
 GraphicObject * FindHitObjectOfType (TypeId type, WORD x, WORD y) {
-    for (GraphicObject *g : VisibleObjects)
-	if (g->TypeID () == type)
+    std::vector<GraphicObject*> near;
+    Grid.Query (SCPointToWP(x, y), near);
+    for (GraphicObject *g : near)
+	if (g->Visible && g->TypeID () == type)
 	    if (g->HitP((long)x, (long)y))
 		return g;
     return NULL;
@@ -445,7 +1119,11 @@ GraphicObject * FindHitObjectOfType (TypeId type, WORD x, WORD y) {
 GraphicObject * FindHitObjectOfTypes (TypeId *keys, int nkeys, WORD x, WORD y){
     long lx = (long) x;
     long ly = (long) y;
-    for (GraphicObject *g : VisibleObjects) {
+    std::vector<GraphicObject*> near;
+    Grid.Query (SCPointToWP(x, y), near);
+    for (GraphicObject *g : near) {
+	if (!g->Visible)
+	    continue;
 	TypeId type = g->TypeID();
 	for (int j = 0; j < nkeys; j++)
 	    if (keys[j] == type)
@@ -519,7 +1197,8 @@ void NXGO_SetViewportDims (int width, int height) {
 //    Viewport.left = Viewport.top = 0;
     Viewport.right = Viewport.left + (long)(width / NXGO_Scale);
     Viewport.bottom = Viewport.top + (long)(height / NXGO_Scale);
-    ComputeVisibleObjectsLast();
+    ComputeVisibleObjectsInView();
+    NXGO_SetScrollPosition(G_mainwindow);
 }
 
 void
@@ -582,7 +1261,8 @@ NXGO_HScroll (HWND window, int code, int pos) {
 	    return;
     }
     Viewport.right = Viewport.left + vpwidth;
-    ComputeVisibleObjects(Viewport);
+    ComputeVisibleObjectsInView();
+    NXGO_SetScrollPosition(window);
     InvalidateRect (window, NULL, 1);
 }
 
@@ -645,7 +1325,8 @@ NXGO_VScroll (HWND window, int code, int pos) {
 	    return;
     }
     Viewport.bottom = Viewport.top + vpheight;
-    ComputeVisibleObjects(Viewport);
+    ComputeVisibleObjectsInView();
+    NXGO_SetScrollPosition(window);
     InvalidateRect (window, NULL, 1);
 }
 
@@ -655,7 +1336,8 @@ void NXGO_SetDisplayScale (double s) {
     ScaleDen = 100;
     Viewport.right = Viewport.left + (long)(VPSCWidth/s);
     Viewport.bottom = Viewport.top + (long)(VPSCHeight/s);
-    ComputeVisibleObjectsLast();
+    ComputeVisibleObjectsInView();
+    NXGO_SetScrollPosition(G_mainwindow);
 }
 
 double NXGO_GetDisplayScale() {
@@ -669,7 +1351,8 @@ void NXGO_SetDisplayWPOrg (WP_cord x, WP_cord y) {
     Viewport.right = x + width;
     Viewport.top = y;
     Viewport.bottom = y + height;
-    ComputeVisibleObjectsLast();
+    ComputeVisibleObjectsInView();
+    NXGO_SetScrollPosition(G_mainwindow);
     InvalidateRect (G_mainwindow, NULL, 1);
 }
 
@@ -725,7 +1408,8 @@ void NXGO_ValidateWpVp(HWND hwnd) {
 	Viewport.left = LRect.left;
 	Viewport.right = Viewport.left + width;
 rcg:
-	ComputeVisibleObjects(Viewport);
+	ComputeVisibleObjectsInView();
+	NXGO_SetScrollPosition(hwnd);
 	InvalidateRect (hwnd, NULL, 0);
     }
     else if (Viewport.right > LRect.right) {
@@ -745,33 +1429,12 @@ void NXGOExtractWPCoords(void* vg, long& x, long& y) {
 
 /* This just duplicates LRect. Figure out how to use that instead. */
 RECT NXGO_ComputeTrueLayoutDimensions() {
-
-    WP_cord lowest_x = 128;
-    WP_cord lowest_y = 128;
-    WP_cord highest_y = 128;
-    WP_cord highest_x = 128;
-    
-    for (GraphicObject * g : AllObjects) {
-        WP_cord x = g->wp_x;
-        WP_cord y = g->wp_y;
-        WP_cord left = x + g->wp_limits.left;
-        WP_cord right = x + g->wp_limits.right;
-        WP_cord top = y + g->wp_limits.top;
-        WP_cord bottom = y + g->wp_limits.bottom;
-        if (top < lowest_y)
-            lowest_y = top;
-        if (bottom > highest_y)
-            highest_y = bottom;
-        if (left < lowest_x)
-            lowest_x = left;
-        if (right > highest_x)
-            highest_x = right;
-    }
+    WPRECT extent = TrueLayoutExtent();
     RECT answer;
     answer.left = 0; //(int) lowest_x;
-    answer.right = (int) highest_x;
+    answer.right = (int) NXMAX(extent.right, 128L);
     answer.top = 0; //(int) lowest_y;  // @#$@$ This negative #!@# (don't care if it's not at origin, we origin.
-    answer.bottom = (int) highest_y;
+    answer.bottom = (int) NXMAX(extent.bottom, 128L);
     //printf ("[%d, %d]->[%d,%d]\n", answer.left, answer.top, answer.right, answer.bottom);
     return answer;
 }
@@ -32,6 +32,11 @@ struct WPPOINT {
     }
 };
 
+/* What is drawn of the panel zoomed out (see NXGO_Overview): the track,
+   which does not change and is kept as an image per scale, and over it
+   the occupancy and routing it shows. */
+enum class OverviewLayer {Track, Indications};
+
 class GraphicObject {
 public:
     GraphicObject ();
@@ -48,6 +53,7 @@ public:
     virtual BOOL    HitP (long x, long y);
     virtual void    HitXY (WORD x, WORD y, WORD message);
     virtual void    Display(HDC dc) = 0;
+    virtual void    DisplayOverview(HDC dc, OverviewLayer layer);
     virtual void    ComputeWP();
     virtual BOOL    ComputeVisible (WPRECT& v);
     virtual TypeId     TypeID();  // not pure - defaiult is -1, no.
@@ -85,7 +91,6 @@ public:
     void	    UnHide();
     void	    ComputeVisibleLast();
     void	    GetVisible();
-    void            ContributeToLayoutRect();
     void            Consume(); /* to fool flow analyzer, which doesn't know
                                 that the constructor stores a reference */
 };
@@ -113,6 +118,14 @@ void ComputeVisibleObjectsLast();
 void ComputeWindowPos();
 void DisplayVisibleObjects (HDC dc);
 void DisplayVisibleObjectsRect (HDC dc, RECT& ur);
+void DisplayVisibleObjectsRects (HDC dc, const RECT * rects, int n);
+void BeginInvalidationBatch();
+void EndInvalidationBatch();
+class InvalidationBatch {	/* the same, by scope, for when exceptions can pass */
+public:
+    InvalidationBatch() {BeginInvalidationBatch();}
+    ~InvalidationBatch() {EndInvalidationBatch();}
+};
 void FreeGraphicObjects();
 int GraphicObjectCount();
 extern GraphicObject * SelectedObject;
@@ -150,6 +163,9 @@ void NXGO_SetScrollPosition(HWND hWnd);
 void NXGO_Rodentate (WORD x, WORD y, WORD mb);
 void NXGO_ValidateWpVp(HWND window);
 RECT NXGO_ComputeTrueLayoutDimensions();
+void NXGO_DisplayLayout (HDC dc, const WPRECT& view, double scale);
+bool NXGO_Overview();
+bool NXGO_TextLegible (WP_cord height);
 
 extern double NXGO_Scale;
 
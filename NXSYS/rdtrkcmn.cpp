@@ -53,6 +53,7 @@ void ValidateRelayWorld();
 std::string InterlockingName;
 char  InterpretedP = 0;
 char  InterlockingLoaded = 0;
+long  InterlockingLoadSerial = 0;
 Relay *CPB0 = NULL;
 std::string INameRetval;
 
@@ -91,6 +92,7 @@ static void FinishUpLoad () {
     ProcessLoadComplete();
     AuxKeysLoadComplete();
     InterlockingLoaded = 1;
+    InterlockingLoadSerial++;
     ReportAllTrackSecsClear ();
     BRGP0 = CreateQuislingRelay (0, "BRGP");
     RAS0 = CreateQuislingRelay (0, "RAS");
@@ -99,6 +101,7 @@ static void FinishUpLoad () {
     EnableDynMenus(TRUE);
     SetUpLayoutTrainMetrics();
 
+    WireRelayDependents();
     map_relay_syms (Goose_Generale, nullptr);
     DropAllApproach();
     void ReportAllTrafficLeversNormal();
@@ -278,6 +281,7 @@ forms:
 	return 1;
     }
     Sexpr rest = CDR(s);
+    SetRelaySourceFile (fname);  // for label diagnostics; INCLUDE changes it
 
     if (symcmp (fn, "QUIT"))
 	return 1;
@@ -4,7 +4,12 @@
 #include <stdarg.h>
 #include <vector>
 #include <queue>
+#include <algorithm>
+#include <functional>
 #include <exception>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
 #include "MessageBox.h"
 
 #if ! NXSYSMac
@@ -27,6 +32,10 @@ int IgnoreDuplicateRelayLabels = 0;
 #include "timers.h"
 #include "cccint.h"
 #include "rlytrapi.h"
+#include "MapperThunker.h"
+#include "Snapshot.hpp"
+#include "RelayJournal.hpp"
+#include "nxgo.h"
 
 static int Initsw = 0;
 static int Halted = 0;
@@ -46,8 +55,8 @@ static void CmplrErr(Relay * err_relay, Sexpr s, const char * string, ...) {
     if (err_relay == nullptr)
 	message = "Relay language error in unknown top-level form:\n";
     else {
-        message += "Relay language error in definition of relay %s:\n";
-        message += err_relay->RelaySym.PRep();
+        message += "Relay language error in definition of relay ";
+        message += err_relay->RelaySym.PRep() + ":\n";
     }
     va_list ap;
     va_start (ap, string);
@@ -110,29 +119,135 @@ static RelayUpdateQueue UpdateQueue;
 static int Trace = 0;
 static tRelayTracer Tracer;
 
+/* Every transition, and every external change that starts some, is
+   recorded in a fixed ring, as cheaply as a few stores, so that it can be
+   left on.  Names are only looked up when the ring is read: by the tracer
+   (above) and the journal (RelayJournal.hpp), fed after each run, or by
+   DumpRelayTrace.  Only the newest TraceRingSize records are kept.  The head
+   is atomic, so a reader elsewhere can tell what it read is still there. */
+struct TraceRecord {
+    Relay * R;
+    uint32_t Wave;              /* external change, with its propagation */
+    uint32_t Time;              /* NXTimerNow(), virtual time included */
+    RelayEvent Kind;
+    char State;
+};
+static const uint64_t TraceRingSize = 1 << 16;
+static TraceRecord TraceRing[TraceRingSize];
+static std::atomic<uint64_t> TraceHead(0);
+static uint64_t TraceBase = 0;  /* older records are of relays now gone */
+static uint64_t TraceFed = 0;   /* through here given to the tracer */
+static bool Journaling = false;
+static uint64_t JournalFed = 0; /* and to the journal */
+static uint32_t TraceWave = 0;
+static uint32_t TraceTime = 0;
+
+static void NewTraceWave () {
+    TraceWave++;
+    TraceTime = (uint32_t)NXTimerNow();
+}
+
+static uint64_t TraceOldest () {
+    uint64_t head = TraceHead.load(std::memory_order_acquire);
+    return (head - TraceBase > TraceRingSize) ? head - TraceRingSize : TraceBase;
+}
+
+static void RecordStimulus (Relay * r, RelayEvent kind, int state) {
+    uint64_t seq = TraceHead.load(std::memory_order_relaxed);
+    TraceRing[seq % TraceRingSize] = {r, TraceWave, (uint32_t)NXTimerNow(), kind, (char)state};
+    TraceHead.store(seq + 1, std::memory_order_release);
+}
+
+/* The journal checkpoints only between runs, when the states it saves
+   agree with the records it has been given. */
+static void FeedTraceReaders () {
+    static bool feeding = false;	/* the tracer can run a message loop */
+    if (feeding)
+        return;
+    feeding = true;
+    if (Journaling) {
+        if (JournalFed < TraceOldest()) {
+            JournalFed = TraceOldest();
+            JournalGap (TraceRing[JournalFed % TraceRingSize].Time);
+        }
+        for (; JournalFed < TraceHead.load(std::memory_order_acquire); JournalFed++) {
+            TraceRecord& rec = TraceRing[JournalFed % TraceRingSize];
+            JournalRelayEvent (rec.R, rec.Kind, rec.State, rec.Time);
+        }
+        if (!Running)
+            JournalQuiescent (NXTimerNow());
+    }
+    if (TraceFed < TraceOldest())
+        TraceFed = TraceOldest();
+    while (Trace && TraceFed < TraceHead.load(std::memory_order_acquire)) {
+        TraceRecord& rec = TraceRing[TraceFed++ % TraceRingSize];
+        if (rec.Kind == RelayEvent::Transition)
+            Tracer (rec.R->RelaySym.u.r->PRep().c_str(), rec.State);
+    }
+    TraceFed = TraceHead.load(std::memory_order_acquire);
+    feeding = false;
+}
+static tRelayRaceHandler RaceHandler = NULL;
+
 class Label {
 public:
-    Label (Sexpr s_, LCommShr* v_) : s(s_), v(v_) {}
+    Label (Sexpr s_, LCommShr* v_, Relay* r_, const std::string& f_) :
+        s(s_), v(v_), definer(r_), file(f_) {}
     Sexpr s;
     LCommShr *v;
+    Relay* definer;             /* for duplicate diagnostics */
+    std::string file;
+    std::string Where() const {
+        std::string w = definer ? "relay " + definer->RelaySym.PRep() : "unknown form";
+        return file.empty() ? w : w + " (" + file + ")";
+    }
 };
 
+/* Labels live as long as the load; LabelTable keeps them in definition order
+   for cleanup, and LabelIndex finds them by atom (atom strings are EQ). */
 static std::vector<Label>LabelTable;
+static std::unordered_map<const char*, size_t> LabelIndex;
+static std::string CurrentSourceFile;
+
+void SetRelaySourceFile (const char * fname) {
+    CurrentSourceFile = fname ? fname : "";
+}
+
+/* Dependents are not wired one at a time as circuits are compiled; that was a
+   linear duplicate search per contact, quadratic for relays like AS or NWC with
+   hundreds of dependents.  Pairs are collected here, and WireRelayDependents
+   sorts, deduplicates and installs them all at once before anything runs.
+   The sequence number preserves the original first-reference order of each
+   relay's dependents, and hence the order of propagation. */
+
+struct DependentPair {
+    Relay * affector;
+    Relay * affected;
+    long seq;
+};
+
+static std::vector<DependentPair> PendingDependents;
 
-static void AddLabel (Sexpr s, LCommShr * v) {
+static void AddLabel (Sexpr s, LCommShr * v, Relay * r) {
     if (v == NULL) {
 	CmplrErr (nullptr, NOBJ, "Null passed to Add Label");
         return; /* placate flow analyzers */
     }
-    for (auto& label : LabelTable) {
-        if (label.s == s) {
-	    if (IgnoreDuplicateRelayLabels)
-		return;
-            else
-		CmplrErr (nullptr, s, "Duplicate label");
-        }
+    auto it = LabelIndex.find(s.u.s);
+    if (it != LabelIndex.end()) {
+        if (IgnoreDuplicateRelayLabels)
+            return;
+        Label here(s, v, r, CurrentSourceFile);
+        CmplrErr (r, s, "Duplicate label, first defined in %s, again in %s",
+                  LabelTable[it->second].Where().c_str(), here.Where().c_str());
     }
-    LabelTable.emplace_back(s, v);
+    LabelIndex[s.u.s] = LabelTable.size();
+    LabelTable.emplace_back(s, v, r, CurrentSourceFile);
+}
+
+static LCommShr * FindLabel (Sexpr s) {
+    auto it = LabelIndex.find(s.u.s);
+    return (it == LabelIndex.end()) ? nullptr : LabelTable[it->second].v;
 }
 
 void DeallocExp (LNode * ln) {
@@ -262,36 +377,54 @@ bool Relay::maybe_change_state(BOOL new_state) {
         return false;
     RelayClicks++;
     State = new_state;
-    if (Trace)
-        Tracer (RelaySym.u.r->PRep().c_str(), State);
+    uint64_t seq = TraceHead.load(std::memory_order_relaxed);
+    TraceRing[seq % TraceRingSize] = {this, TraceWave, TraceTime, RelayEvent::Transition, (char)State};
+    TraceHead.store(seq + 1, std::memory_order_release);
     if (Flags & LF_Reporting)
         ((ReportingRelay *)this)->Report();
     UpdateQueue.put(this);
     return true;
 }
 
-static void Run (Relay * top_level_relay, BOOL force_new_state) {
-
-    class RunLevelSet {
-    public:
-        RunLevelSet() {assert(!Running); Running = true;}
-        ~RunLevelSet() {Running = false;}
-    } setter;
-
-    top_level_relay->maybe_change_state(force_new_state);
+class RunLevelSet {
+public:
+    RunLevelSet() {assert(!Running); Running = true;}
+    ~RunLevelSet() {Running = false;}
+};
 
+/* The instability limit is per external change propagated. */
+static void Propagate (int changes) {
     int run_transition_count = 0;
     while (!UpdateQueue.empty() && !Halted) {
         Relay * r = UpdateQueue.take();
         for (auto dependent : r->Dependents) {
             assert(dependent->exp);
             if (dependent->maybe_change_state(dependent->ComputeValue()))
-                if (++run_transition_count > RCT_MAX)
-                    NxsysAppAbort (0, "RELAY RACE! Apparent relay logic instability.");
+                if (++run_transition_count > RCT_MAX * changes) {
+                    const char * msg = "RELAY RACE! Apparent relay logic instability.";
+                    FeedTraceReaders();
+                    if (RaceHandler)
+                        RaceHandler (msg);
+                    NxsysAppAbort (0, msg);
+                }
         }
     }
 }
 
+/* The external change that starts a wave is recorded in it, as the first
+   record; Transition, for none (the relay's own transition says it all). */
+static void Run (Relay * top_level_relay, BOOL force_new_state,
+                 RelayEvent stimulus = RelayEvent::Transition) {
+
+    WireRelayDependents();
+    RunLevelSet setter;
+    NewTraceWave();
+    if (stimulus != RelayEvent::Transition)
+        RecordStimulus (top_level_relay, stimulus, force_new_state);
+    top_level_relay->maybe_change_state(force_new_state);
+    Propagate(1);
+}
+
 
 
 /* Featurette 27 December 1996 - async mouse-ups can try to recurse
@@ -300,11 +433,12 @@ static void Run (Relay * top_level_relay, BOOL force_new_state) {
 class DelayQE {
     Relay * relay;
     BOOL    state;
+    RelayEvent stimulus;
 public:
-    DelayQE(Relay* r, BOOL s) :
-      relay(r), state(s) {}
+    DelayQE(Relay* r, BOOL s, RelayEvent k) :
+      relay(r), state(s), stimulus(k) {}
     void run() {
-        Run(relay, state);
+        Run(relay, state, stimulus);
     }
 };
 
@@ -315,23 +449,28 @@ static void EmptyDelayQueue () {
         DelayQueue.pop();
 }
 
+/* Each external change, with all it propagates and all that was queued
+   behind it, is one invalidation batch, so the panel repaints what a wave
+   changed once, when it has settled, rather than as each reporter runs. */
 static void RunDelayQueue () {
     if (!Running)
         while (!DelayQueue.empty()) {
             DelayQueue.front().run();
             DelayQueue.pop();
 	}
+    FeedTraceReaders();
     CheckRelayDisplay();
 }
 
-static void ExtRun (Relay * r, BOOL state) {
+static void ExtRun (Relay * r, BOOL state, RelayEvent stimulus) {
     if (Running)
-        DelayQueue.emplace(r, state);
+        DelayQueue.emplace(r, state, stimulus);
     else
-	Run (r, state);
+	Run (r, state, stimulus);
 }
 
 void GooseRelay (Relay * rr) {
+    InvalidationBatch batch;
     int state;
 #if defined(CALL_COMPILED) && defined(NXCMPOBJ)
     if (rr->Flags & LF_CCExp)
@@ -345,27 +484,63 @@ void GooseRelay (Relay * rr) {
     RunDelayQueue();
 }
 
-void ReportToRelay (Relay* r, BOOL state) {
+static void Stimulate (Relay* r, BOOL state, RelayEvent kind) {
     if (r == NULL)
 	return;
     if (state == r->State)
 	return;
-    ExtRun (r, state);
+    InvalidationBatch batch;
+    ExtRun (r, state, kind);
+    RunDelayQueue();
+}
+
+void ReportToRelay (Relay* r, BOOL state) {
+    Stimulate (r, state, RelayEvent::Report);
+}
+
+/* Several external changes at once (e.g., all the track circuits a train
+   stepper tick changed) go into one propagation.  Reports of the state a
+   relay is already in are dropped, as by Stimulate. */
+void ReportToRelays (Relay * const * relays, const BOOL * states, int n) {
+    InvalidationBatch batch;
+    std::vector<int> changes;
+    for (int i = 0; i < n; i++)
+        if (relays[i] != NULL && states[i] != relays[i]->State)
+            changes.push_back(i);
+    if (changes.empty())
+        return;
+    if (Running) {
+        for (int i : changes)
+            ExtRun (relays[i], states[i], RelayEvent::Report);
+        return;
+    }
+    WireRelayDependents();
+    {
+        RunLevelSet setter;
+        NewTraceWave();
+        for (int i : changes)
+            RecordStimulus (relays[i], RelayEvent::Report, states[i]);
+        for (int i : changes)
+            relays[i]->maybe_change_state(states[i]);
+        Propagate((int)changes.size());
+    }
     RunDelayQueue();
 }
 
 void ToggleToRelay (Relay* r) {
     if (r == NULL)
 	return;
-    ExtRun (r, !r->State);
+    InvalidationBatch batch;
+    ExtRun (r, !r->State, RelayEvent::Toggle);
     RunDelayQueue();
 }
 
 void PulseToRelay (Relay * r) {
     if (r == NULL)
 	return;
-    ExtRun (r, 1);
-    ExtRun (r, 0);
+    InvalidationBatch batch;
+    ExtRun (r, 1, RelayEvent::Pulse);
+    ExtRun (r, 0, RelayEvent::Transition);
     RunDelayQueue();
 }
 
@@ -436,7 +611,7 @@ static LNode * CompileExpr (Sexpr s, Relay* r) {
 	    if (CDR(s).type != Lisp::tCONS)
                 CmplrErr (r, NOBJ, "Bad Format LABEL clause.");
 	    LCommShr * v = new LCommShr (CompileAsAnd (CDR(s), r));
-	    AddLabel (CAR(s), v);
+	    AddLabel (CAR(s), v, r);
 	    return v;
 	}
 	else {
@@ -455,12 +630,9 @@ static LNode * CompileExpr (Sexpr s, Relay* r) {
 	    return &ZERO;
 	else if (s == T_ATOM)
 	    return &ONE;
-	else {
-            for (auto& theLabel : LabelTable)
-		if (theLabel.s == s) {
-		    PropagateDescendent (theLabel.v, r);
-		    return theLabel.v;
-		}
+	else if (LCommShr * v = FindLabel (s)) {
+	    PropagateDescendent (v, r);
+	    return v;
 	}
 	CmplrErr (r, s, "Logic label not found");
     }
@@ -530,7 +702,7 @@ void TimerTimeFcn (void * v) {
    to just ignore it. 2 October 1996 */
 //    if (GetTickCount () >= tc->StartedTiming + tc->Interval) {
 	tc->Timing = 0;
-	ReportToRelay (tc->Outter, tc->Ctrler->State);
+	Stimulate (tc->Outter, tc->Ctrler->State, RelayEvent::TimerFired);
 //    }
 //    else NxsysAppAbort (0, "Premature timer firing.");
 }
@@ -593,6 +765,63 @@ Relay * DefineTimerRelayFromObject (Relay* outter, int t) {
     return ctrler;
 }
 
+/* Snapshot and rewind (Snapshot.hpp).  Relays are saved by address, as the
+   relay symbol table may be rehashed by lookups in between.  Restoring sets
+   states outright, with no propagation, as the snapshot was of a quiescent
+   network; each change is recorded as a transition, so the trace and the
+   journal see it.  Reporters of relays that changed are called, so that panel
+   objects follow; what they ask of other relays is dropped, and timers and
+   coders they start are replaced by the snapshot's own, restored after. */
+
+void SnapshotRelays (SnapshotWriter& w) {
+    std::vector<Relay*> relays;
+    auto pusher = [&](Rlysym * rsp, void*) {
+        if (rsp->rly)
+            relays.push_back(rsp->rly);
+    };
+    map_relay_syms(single_arg_thunker<Rlysym*>(pusher), &pusher);
+    w.Put(relays.size());
+    for (Relay * r : relays) {
+        w.Put(r);
+        w.Put(r->State);
+    }
+    w.Put(Timers.size());
+    for (auto& tc : Timers)
+        w.Put(tc->Timing);
+}
+
+void RestoreRelays (SnapshotReader& r) {
+    std::vector<ReportingRelay*> changed;
+    size_t n = r.Get<size_t>();
+    NewTraceWave();             /* the changes are one wave, for the journal */
+    for (size_t i = 0; i < n; i++) {
+        Relay * rly = r.Get<Relay*>();
+        char state = r.Get<char>();
+        if (rly == NULL || rly->State == state)
+            continue;
+        rly->State = state;
+        RecordStimulus (rly, RelayEvent::Transition, state);
+        if (rly->Flags & LF_Reporting)
+            changed.push_back((ReportingRelay *)rly);
+    }
+    {
+        RunLevelSet setter;
+        for (ReportingRelay * rly : changed)
+            rly->Report();
+    }
+    EmptyDelayQueue();
+    UpdateQueue.reset();        /* a run abandoned to a race handler */
+
+    size_t ntimers = r.Get<size_t>();
+    for (size_t i = 0; i < ntimers; i++) {
+        int timing = r.Get<int>();
+        if (i < Timers.size())
+            Timers[i]->Timing = timing;
+    }
+    FeedTraceReaders();
+    CheckRelayDisplay();
+}
+
 Relay * DefineRelayFromLisp2 (Sexpr S, Sexpr exp) {
     try {
         if (S.type != Lisp::RLYSYM)
@@ -623,10 +852,48 @@ Logop::Logop (LogOp t, int n) : LNode() {
 
 void Relay::AddDependent (Relay * dependent) {
     assert(dependent && "Dependent should not be null");
-    for (Relay* maybe : Dependents)
-        if (dependent == maybe)
-            return;
-    Dependents.push_back(dependent);
+    PendingDependents.push_back({this, dependent, (long)PendingDependents.size()});
+}
+
+void WireRelayDependents () {
+    auto& P = PendingDependents;
+    if (P.empty())
+        return;
+    /* Relays defined after an earlier wiring keep their existing dependents
+       first (negative sequence numbers), merged with the new ones. */
+    size_t npending = P.size();
+    for (size_t i = 0; i < npending; i++) {
+        Relay * r = P[i].affector;
+        long ndeps = (long)r->Dependents.size();
+        for (long j = 0; j < ndeps; j++)
+            P.push_back({r, r->Dependents[j], j - ndeps});
+        r->Dependents.clear();
+    }
+    std::sort(P.begin(), P.end(), [](const DependentPair& a, const DependentPair& b) {
+        if (a.affector != b.affector)
+            return std::less<Relay*>()(a.affector, b.affector);
+        if (a.affected != b.affected)
+            return std::less<Relay*>()(a.affected, b.affected);
+        return a.seq < b.seq;
+    });
+    P.erase(std::unique(P.begin(), P.end(), [](const DependentPair& a, const DependentPair& b) {
+        return a.affector == b.affector && a.affected == b.affected;
+    }), P.end());
+    std::sort(P.begin(), P.end(), [](const DependentPair& a, const DependentPair& b) {
+        if (a.affector != b.affector)
+            return std::less<Relay*>()(a.affector, b.affector);
+        return a.seq < b.seq;
+    });
+    for (size_t i = 0; i < P.size();) {
+        size_t j = i;
+        while (j < P.size() && P[j].affector == P[i].affector)
+            j++;
+        auto& deps = P[i].affector->Dependents;
+        deps.reserve(j - i);
+        for (; i < j; i++)
+            deps.push_back(P[i].affected);
+    }
+    P.clear();
 }
 
 void ValidateRelayWorld();
@@ -692,16 +959,20 @@ static void CleanupLabelTableShrefs() {
 }
 
 void CleanUpRelaySys () {
+    StopRelayJournal();
     UpdateQueue.reset();
+    TraceBase = TraceFed = JournalFed = TraceHead.load();
     Running = false;
     ValidateRelayWorld();
     Timers.clear();  //deletes blocks via unique_ptrs.
     EmptyDelayQueue();
+    PendingDependents.clear();
 //    ValidateRelayWorld();
     map_relay_syms_method (&Rlysym::DestroyRelayLogic);
     CleanupLabelTableExps();
     CleanupLabelTableShrefs();
     LabelTable.clear();
+    LabelIndex.clear();
     map_relay_syms_method (&Rlysym::DestroyRelay);
 
     Halted = 0;
@@ -711,6 +982,7 @@ void CleanUpRelaySys () {
 int RelayUseDefined (Relay * rr) {
     if (rr == NULL)
 	return 0;
+    WireRelayDependents();
     return rr->Dependents.size() > 0;
 }
 
@@ -724,7 +996,33 @@ void SetRelayTrace (tRelayTracer function)  {
     else {
 	Trace = 1;
 	Tracer = function;
+	TraceFed = TraceHead.load();	/* from now on */
+    }
+}
+
+void SetRelayJournaling (bool on) {
+    Journaling = on;
+    JournalFed = TraceHead.load();
+}
+
+int DumpRelayTrace (const char * path) {
+    FILE * f = fopen (path, "w");
+    if (f == NULL)
+        return 0;
+    static const char * const kinds[] = {"", "REPORT", "TOGGLE", "PULSE", "TIMER"};
+    fprintf (f, "    Wave      Time          State  Relay\n");
+    for (uint64_t seq = TraceOldest(); seq < TraceHead.load(std::memory_order_acquire); seq++) {
+        TraceRecord& rec = TraceRing[seq % TraceRingSize];
+        fprintf (f, "%8lu %9lu  %-6s  %s   %s\n", (unsigned long)rec.Wave, (unsigned long)rec.Time,
+                 kinds[(int)rec.Kind], rec.State ? "PICK" : "DROP",
+                 rec.R->RelaySym.u.r->PRep().c_str());
     }
+    fclose (f);
+    return 1;
+}
+
+void SetRelayRaceHandler (tRelayRaceHandler function) {
+    RaceHandler = function;
 }
 
 bool relay_has_exp(Relay* r) {
@@ -96,6 +96,8 @@ Relay* DefineTimerRelayFromObject (Relay* r, int time);
 Relay* InitRelay (Relay & rr, Sexpr rlysym);
 void InitRelaySys();
 void GooseRelay (Relay * rr);
+void WireRelayDependents();
+void SetRelaySourceFile (const char * fname);
 void PulseToRelay (void *);
 Sexpr ZAppendRlysym (Sexpr base);
 extern int IgnoreDuplicateRelayLabels;
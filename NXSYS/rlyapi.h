@@ -13,6 +13,7 @@ void MoveReporterAssociatedObject(ReportingRelay* relay, void* object);
 
 extern int RelayUseDefined (Relay * rr);
 extern void ReportToRelay (Relay *, BOOL);
+extern void ReportToRelays (Relay * const * relays, const BOOL * states, int n);
 extern void PulseToRelay (Relay *);
 extern Relay * CreateQuislingRelay (long, const char *);
 extern Relay * GetRelay2NoCreate (long, const char *);
@@ -6,6 +6,7 @@
 #include "ldraw.h"
 #include "RLYINDEX.H"
 #include "compat32.h"
+#include "SVGPlot.hpp"
 
 static HFONT F1, F2;
 static int PageWidth, PageHeight;
@@ -142,7 +143,10 @@ static int sortids (const void *a, const void* b) {
 
 
 
-static void PrintRelayType (HDC dc, int X, int Y, int xc,
+/* These draw on a printer's HDC or an SVGPlot. */
+
+template <class DC>
+static void PrintRelayType (DC dc, int X, int Y, int xc,
 			    int cellh, int cellw, int NNums, int idt) {
     RECT txr;
     txr.left = X + cellw*xc;
@@ -156,7 +160,8 @@ static void PrintRelayType (HDC dc, int X, int Y, int xc,
 	      DT_VCENTER | DT_CENTER |DT_SINGLELINE| DT_NOCLIP);
 }
 
-static void PrintItemNumber (HDC dc, int X, int Y, int yc,
+template <class DC>
+static void PrintItemNumber (DC dc, int X, int Y, int yc,
 			     int cellh, int cellw, int nids, long inum) {
     RECT txr;
     txr.left = X- 1*cellw;
@@ -170,7 +175,8 @@ static void PrintItemNumber (HDC dc, int X, int Y, int yc,
 	      DT_VCENTER | DT_LEFT |DT_SINGLELINE| DT_NOCLIP);
 }
 
-static void PrintPageNum (HDC dc, int X, int Y, int x, int y,
+template <class DC>
+static void PrintPageNum (DC dc, int X, int Y, int x, int y,
 			  int cellh, int cellw, int page) {
     RECT txr;
     txr.left = X + x*cellw;
@@ -178,11 +184,14 @@ static void PrintPageNum (HDC dc, int X, int Y, int x, int y,
     txr.top = Y + y*cellh;
     txr.bottom = txr.top + cellh;
     std::string num(std::to_string(page));
+    BeginPageLink (dc, page);
     DrawText (dc, num.c_str(), (int)num.length(), &txr,
 	      DT_VCENTER | DT_CENTER |DT_SINGLELINE| DT_NOCLIP);
+    EndLink (dc);
 }
 
-static void ProduceOneRelayIndex (HDC dc, Filter filter, const char * title,
+template <class DC>
+static void ProduceOneRelayIndex (DC dc, Filter filter, const char * title,
 				  int(*moreproc)(void)) {
     Philtre = filter;
     
@@ -341,8 +350,9 @@ static void ProduceOneRelayIndex (HDC dc, Filter filter, const char * title,
 
 
 
-void ProduceRelayIndex (HDC dc, int (*moreproc) (void),
-			HFONT f1, HFONT f2, int width, int height) {
+template <class DC>
+static void ProduceRelayIndexOn (DC dc, int (*moreproc) (void),
+				 HFONT f1, HFONT f2, int width, int height) {
     Xused = 0;
     Yused = 0;
     F1 = f1;
@@ -356,4 +366,14 @@ void ProduceRelayIndex (HDC dc, int (*moreproc) (void),
     ProduceOneRelayIndex (dc, RandomFilter, "Global Index", moreproc);
 }
 
+void ProduceRelayIndex (HDC dc, int (*moreproc) (void),
+			HFONT f1, HFONT f2, int width, int height) {
+    ProduceRelayIndexOn (dc, moreproc, f1, f2, width, height);
+}
+
+void ProduceRelayIndex (SVGPlot * plot, int (*moreproc) (void),
+			HFONT f1, HFONT f2, int width, int height) {
+    ProduceRelayIndexOn (plot, moreproc, f1, f2, width, height);
+}
+
 
@@ -6,5 +6,11 @@ BOOL RelayTraceExposedP();
 void EnableRelayTrace(BOOL expose_it);
 typedef void (*tRelayTracer) (const char * s, int state);
 void SetRelayTrace (tRelayTracer);
+int  DumpRelayTrace (const char * path);	/* the whole ring; 0 if can't write */
+void SetRelayJournaling (bool on);		/* feed RelayJournal.hpp from the ring */
+
+/* Called instead of the fatal abort on a relay race; must not return. */
+typedef void (*tRelayRaceHandler) (const char * message);
+void SetRelayRaceHandler (tRelayRaceHandler);
 
 #endif
@@ -182,18 +182,9 @@ BOOL Signal::ShouldBeCoding () {
 void Signal::GKCoder (BOOL state) {
     if (!PSignal->Visible)
 	return;
-    if (ShouldBeCoding()) {
+    if (ShouldBeCoding())
 	Coding = state ? 1 : 2;
-#ifdef NXSYSMac
-        Invalidate();
-#else
-	HDC dc = GetDC (G_mainwindow);
-	PSignal->Display(dc);
-	ReleaseDC (G_mainwindow, dc);
-#endif
-    }
-    else
-	Invalidate();
+    Invalidate();		/* repainted with the rest of the blip */
 }
 
 
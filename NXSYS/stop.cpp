@@ -53,15 +53,8 @@ int Stop::PressStopPB() {
     return 0;
 }
 void Stop::CodingDisplay() {
-    if (ShowStopPolicy != SHOW_STOPS_NEVER) {
-#ifdef NXSYSMac
-        Invalidate();
-#else
-	HDC dc = GetDC (G_mainwindow);
-	Display (dc);
-	ReleaseDC (G_mainwindow, dc);
-#endif
-    }
+    if (ShowStopPolicy != SHOW_STOPS_NEVER)
+        Invalidate();		/* batched when from a coder blip */
     Sig->UpdateStop();
 }
 
@@ -168,8 +168,10 @@ Virtual void SwitchKey::Display (HDC hdc) {
     int bm = GetBkMode (hdc);
     SetBkMode (hdc, TRANSPARENT);
     SetTextColor (hdc, RGB (0, 0, 0));
-    DrawText (hdc, "N", 1, &rn, LIGHT_LEGEND_DT_OPTS);
-    DrawText (hdc, "R", 1, &rr, LIGHT_LEGEND_DT_OPTS);
+    if (NXGO_TextLegible (Height/2)) {
+	DrawText (hdc, "N", 1, &rn, LIGHT_LEGEND_DT_OPTS);
+	DrawText (hdc, "R", 1, &rr, LIGHT_LEGEND_DT_OPTS);
+    }
     SetTextColor (hdc, tcold);
     SetBkMode (hdc, bm);
     SelectObject (hdc, GetStockObject (BLACK_PEN));
@@ -180,7 +182,8 @@ Virtual void SwitchKey::Display (HDC hdc) {
     RECT tr = r;
     tr.top = r.bottom + BottomMargin;
     tr.bottom = tr.top + NumHeight;
-    DrawText (hdc, NumStr, NumStrLen, &tr, NUM_DT_OPTS);
+    if (NXGO_TextLegible (NumHeight))
+	DrawText (hdc, NumStr, NumStrLen, &tr, NUM_DT_OPTS);
 
     /* Lock light */
     SelectObject (hdc, LSState ? GKOffBrush : GKRedBrush);
@@ -1,5 +1,6 @@
 #include "windows.h"
 #include <string.h>
+#include <stdlib.h>
 #include <vector>
 #include "text.h"
 #include "typeid.h"
@@ -111,6 +112,10 @@ void TextString::ScaleSelf () {
 void TextString::Display (HDC hdc) {
     if (NXGO_Scale != S.AssumedScale)
 	ScaleSelf();
+    /* wp_limits are already scaled (ScaleSelf); the font's own height is not */
+    int height = abs (RedeemLogfont().lfHeight);
+    if (!NXGO_TextLegible (height ? height : NXSYS_DEFAULT_TEXT_HEIGHT))
+	return;
 
     RECT r;
     r.left = WPXtoSC (wp_x + wp_limits.left);
@@ -133,6 +138,12 @@ void TextString::Display (HDC hdc) {
     SelectObject (hdc, Fnt);
 }
 
+/* Titles big enough to read zoomed out are part of the track's picture. */
+void TextString::DisplayOverview (HDC hdc, OverviewLayer layer) {
+    if (layer == OverviewLayer::Track)
+	Display (hdc);
+}
+
 #if TLEDIT
 bool TextString::MouseSensitive() {return true;}
 #else
@@ -36,6 +36,7 @@ public:
 
     /* funciones virtuales de GraphicObject */
     virtual void    Display(HDC dc) ;
+    virtual void    DisplayOverview(HDC dc, OverviewLayer layer);
     virtual TypeId  TypeID();
     virtual BOOL    HitP (long x, long y);
     virtual bool    MouseSensitive();
@@ -10,6 +10,14 @@ void NXCoder (void* object, CoderFn fn);
 void KillOneCoder (void* object);
 void NXFastCoder (void* object, CoderFn fn);
 void KillOneFastCoder (void* object);  /* uh oh ....:) */
+void ResetCoders();                    /* for KillNXTimers */
 
 void RunTimers();
 void HaltTimers();
+
+/* Virtual time, for headless simulation.  While on, NXTimer arms no platform
+   timers; AdvanceVirtualTime matures those falling due, in time order.
+   Turning it off rearms what is left for the time that remained. */
+void SetVirtualTime (bool on);
+void AdvanceVirtualTime (long ms);
+DWORD NXTimerNow ();
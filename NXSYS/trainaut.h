@@ -15,5 +15,6 @@ BOOL TrainAutoLookupCommand (const char * scmd, int&icmd);
 #define TRAIN_CTL_HIDEDLG  2
 #define TRAIN_CTL_HALTED   4
 #define TRAIN_CTL_FREEWILL 8
+#define TRAIN_CTL_HEADLESS 16   /* no dialog at all -- capacity simulation */
 
 #endif
@@ -7,7 +7,9 @@ extern double
 extern void SetTrainKinematicsDefaults();
 
 #ifdef NXV2
+class Turnout;
 extern void SetUpLayoutTrainMetrics();
+extern void InvalidateTrainLookahead(Turnout * tn);
 #endif
 
 #endif
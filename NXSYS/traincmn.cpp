@@ -67,6 +67,9 @@ void setSliderValue(HWND, int, int);
 #include <string>
 #include "STLExtensions.h"
 #include "WinApiSTL.h"
+#include "CapacitySimulation.hpp"
+#include "Snapshot.hpp"
+#include "MonteCarlo.hpp"
 
 #if NXOGL
 const int INTVL_MS = 200;		/* was 5 */
@@ -93,7 +96,7 @@ static void MakeTrainGenId (GraphicObject* tk, int options);
 /*
  Protocol -- only the unique_ptr in this map can create OR DELETE the actual trains.  There is no way to get a Train*
  pointer out of it, or any other way.  However, methods of Train can hand "this" to other agents for callback, and this is
- dangerous.  There are three necessary cases now, (1) the NXTimer system for train motion (2) Hooks in signals to prompt
+ dangerous.  There are three necessary cases now, (1) the train stepper's list of moving trains (2) Hooks in signals to prompt
  train motion by signal change (and there were retention bugs here seen in 1996!!) (3) the train dialog itself.
  
  The current protocol (10 Aug 2019) is that all such callbacks must validate the pointers given to them by calling
@@ -101,7 +104,8 @@ static void MakeTrainGenId (GraphicObject* tk, int options);
  it will refuse to dereference the unique_ptr, which is exactly right)
  
  The dialogs and signals could be changed to shared_ptr's (and the unique_ptr as well), but this is not only overheady,
- but cannot possibly work for the timer system, which must be general enough to accept any pointers.
+ but cannot possibly work for the timer system, which must be general enough to accept any pointers.  The stepper
+ needs no validation; the destructor takes the train out of its list (StopStepping).
  
  Trains disappear by calling vanish(), which erases the map entry (or Kill All, which calls map::clear). No one can
  invoke the destructor explicitly (i.e., only STL reference counting may invoke it).
@@ -138,6 +142,81 @@ public:
 
 static Popinvect<int> FreedTrainNumbers;
 
+/* The train stepper.  All moving trains are advanced in one pass off one shared
+   NXTimer every INTVL_MS, rather than each train running its own timer, which
+   runs the platform out of timers long before capacity-study train counts.
+   Moving is dense; each train knows its slot, so joining and leaving are O(1).
+   Track occupancy changed during a pass is counted at once, but track relays
+   hear of it once per circuit, in one relay propagation, at the end of the pass. */
+
+static std::vector<Train*> Moving;
+static bool StepperRunning = false;
+static bool Stepping = false;
+static long StepTime = 0;
+
+static void StartStepper () {
+    if (!StepperRunning) {
+        StepperRunning = true;
+        NXTimer (&Moving, Train::StepAllTrains, INTVL_MS);
+    }
+}
+
+void Train::StepAllTrains (void *) {
+    StepperRunning = false;
+    Stepping = true;
+    StepTime = NXTimerNow();   // one clock reading for the whole pass
+    DeferTrackCircuitReports();
+    InvalidationBatch batch;   // the whole pass repaints as one
+
+    /* Trains that stop or vanish during the pass null their slots; trains that
+       start during it are appended, and take their first step next tick. */
+    size_t n = Moving.size();
+    for (size_t i = 0; i < n; i++)
+        if (Moving[i] != nullptr)
+            Moving[i]->ComputeNextMotion();  //Can vanish the Train
+
+    CompactMoving();
+    FlushTrackCircuitReports();
+    if (Moving.size())
+        StartStepper();
+}
+
+void Train::CompactMoving () {
+    Stepping = false;
+    size_t j = 0;
+    for (size_t i = 0; i < Moving.size(); i++)
+        if (Moving[i] != nullptr) {
+            Moving[i]->StepSlot = (int)j;
+            Moving[j++] = Moving[i];
+        }
+    Moving.resize(j);
+}
+
+void Train::StartStepping() {
+    if (StepSlot < 0) {
+        StepSlot = (int)Moving.size();
+        Moving.push_back(this);
+        StartStepper();
+    }
+}
+
+void Train::StopStepping() {
+    if (StepSlot < 0)
+        return;
+    if (Stepping)
+        Moving[StepSlot] = nullptr;   // compacted at end of pass
+    else {
+        Moving[StepSlot] = Moving.back();
+        Moving[StepSlot]->StepSlot = StepSlot;
+        Moving.pop_back();
+        if (Moving.empty() && StepperRunning) {
+            KillOneTimer (&Moving);
+            StepperRunning = false;
+        }
+    }
+    StepSlot = -1;
+}
+
 static void MakeTrainN (int train_no,GraphicObject* tk, int options) {
     assert (train_no != 0);
     assert (Trains.count(train_no) == 0);
@@ -222,7 +301,8 @@ void Train::StringFldF(int id, const char* fmt, ...) {
 }
 
 void Train::StringFld (int id, const char* text) {
-    NBDSetWindowText (GetDlgItem (Dialog, id), text);
+    if (Dialog)
+        NBDSetWindowText (GetDlgItem (Dialog, id), text);
 }
 
 void Train::StringFld(int id, const std::string& str) {
@@ -231,6 +311,8 @@ void Train::StringFld(int id, const std::string& str) {
 
 void Train::ReportSig (Signal* g, int nameid, int stateid) {
 
+    if (Dialog == NULL)
+        return;
     bool call_on = false;
     if (g == NULL) {
 	StringFld (nameid, "None");
@@ -263,11 +345,15 @@ void Train::ReportSig (Signal* g, int nameid, int stateid) {
     
 
 void Train::UpdateSwitches () {
+    if (Dialog == NULL)
+        return;
     SendDlgItemMessage (Dialog, TRD_OBSERVANT, BM_SETCHECK, observant, 0L);
     SendDlgItemMessage (Dialog, TRD_DEFIANT, BM_SETCHECK, !observant, 0L);
 }
 
 void Train::UpdatePositionReport () {
+    if (Dialog == NULL)
+        return;
 
     StringFldF(TRD_LOC, "%s+%02d", front.LastIJID,
 	     (int)(100.0*front.FeetSinceLastIJ));
@@ -299,13 +385,16 @@ Train::Train (int train_no, GraphicObject * g, int options) {
     TrainNoMax = NXMAX(TrainNoMax, train_no);
     observant = ((options & TRAIN_CTL_HALTED) == 0);
    
-    TimerPending = false;
+    StepSlot = -1;
+    Dialog = NULL;
+    if ((options & TRAIN_CTL_HEADLESS) == 0) {
 #if NXSYSMac
-    Dialog = MacCreateTrainDialog(this, id, observant);  // VIOLATING unique_ptr protocol
+        Dialog = MacCreateTrainDialog(this, id, observant);  // VIOLATING unique_ptr protocol
 #else
-    DLGPROC dd = reinterpret_cast<DLGPROC>(&Train_DlgProc);
-    Dialog = CreateDialog (app_instance, "Train", G_mainwindow, dd);
+        DLGPROC dd = reinterpret_cast<DLGPROC>(&Train_DlgProc);
+        Dialog = CreateDialog (app_instance, "Train", G_mainwindow, dd);
 #endif
+    }
 
     Length = Glb.TrainLengthFeet;
     Cruise = CruisingSpeed;
@@ -315,10 +404,15 @@ Train::Train (int train_no, GraphicObject * g, int options) {
     CODisplay = false;
     TrackUnit * ts = (TrackUnit *) g;
     X_Of_Next_Signal = 0.0;
+    LostMS = 0.0;
     InitPositionTracking(ts);
     NextSig = NULL;
+    Time = NXTimerNow();
+    if (Dialog == NULL) {
+        InitPosition();
+        return;
+    }
     SetWindowTextS (Dialog, FormatString("#%d Train Control", id));
-    Time = GetTickCount();
     StringFld(TRD_TRAIN_ID, std::to_string(id));
     StringFld(TRD_LENGTH, std::to_string((int)Length));
 #if ! NXSYSMac
@@ -432,10 +526,15 @@ void Train::Observance () {
 
 void Train::ComputeNextMotion() {
     /*This method will DELETE THIS TRAIN when tripped */
-    long now = GetTickCount();
+    long now = Stepping ? StepTime : (long)NXTimerNow();
     /* overflow 32 seconds?  in debugger?*/
 
     int interval = (int)(now - Time);
+    if (CapacitySimulating && Cruise > 0.0) {
+        LostMS += interval * (1.0 - Speed/Cruise);
+        if (Speed == 0.0 && NextSig != NULL)
+            CapacityNoteStanding (NextSig, interval);
+    }
     double move = ((double)interval*(Speed/100.0))/1000.0; /* ms, not seconds */
     double flength = (double) Length/100.0;
     front.x += move;
@@ -447,6 +546,8 @@ void Train::ComputeNextMotion() {
     Signal * was_next_sig =  NextSig;
     InstallNextSig ();
     if (!ComputeOccupations()) {
+        if (CapacitySimulating)
+            CapacityNoteTrainGone (id, front.LastIJID, LostMS, NULL);
         vanish();
 	return;
     }
@@ -459,16 +560,23 @@ void Train::ComputeNextMotion() {
 	    return;			/* deleted THIS */
 	}
     if (Speed > 0.0)
-	if (!TimerPending) {
-	    TimerPending = true;
-	    NXTimer (this, StaticTimerHandler, INTVL_MS);  //VIOLATES unique_ptr with permission
-	}
+	StartStepping();   //VIOLATES unique_ptr with permission
+    else
+	StopStepping();
 }
 
 void Train::Trip (Signal * g) {
     observant = false;
     UpdateSwitches();
     SetSpeed (0.0);
+    if (CapacitySimulating)
+        CapacityNoteTrainGone (id, front.LastIJID, LostMS, g);
+    if (MonteCarloRunning)
+        MonteCarloNoteTrip (id, g);
+    if (Dialog == NULL) {
+        vanish();
+        return;
+    }
     std::string msg(FormatString("Train #%d has overrun signal %s and been tripped "
                                  "by its automatic train stop. This train will be destroyed.",
                                  id, g->CompactName().c_str()));
@@ -508,8 +616,10 @@ void Train::MaybeNoticeSignalChange (Signal * g) {
 void Train::InstallNextSig () {
     Signal * g = FindNextSig ();
     if (g != NextSig) {
-	StringFld (TRD_LAST_SIG_NAME, GetDlgItemText(Dialog, TRD_NEXT_SIG_NAME));
-	StringFld (TRD_LAST_SIG_STATE, GetDlgItemText(Dialog, TRD_NEXT_SIG_STATE));
+        if (Dialog) {
+	    StringFld (TRD_LAST_SIG_NAME, GetDlgItemText(Dialog, TRD_NEXT_SIG_NAME));
+	    StringFld (TRD_LAST_SIG_STATE, GetDlgItemText(Dialog, TRD_NEXT_SIG_STATE));
+        }
 
 	if (g != NULL)
             g->Hook(this);    // Moby VIOLATES unique_ptr protocol.  Callback calls ValidateWanderedPointer.
@@ -520,31 +630,32 @@ void Train::InstallNextSig () {
     }
 }
 
-void Train::StaticTimerHandler (void * v) {
-    ValidateWanderedPointer(v)->TimerHandler();
+bool Train::OccupiesP (TrackUnit * ts, size_t from) {
+    for (size_t i = from; i < Occupied.size(); i++)
+        if (Occupied[i].ts == ts)
+            return true;
+    return false;
 }
 
-void Train::TimerHandler(){
-    assert(TimerPending && "Timer handler called with no apparent timer pending on this train.");
-    TimerPending = false;
-    ComputeNextMotion();  //Can vanish the Train
+/* The front has just entered ts.  A train long enough to meet its own back
+   (on a loop) counts a seg only once. */
+void Train::SetOccupied (TrackUnit * ts) {
+    bool already = OccupiesP(ts);
+    Occupied.push_back({ts, front.x_at_seg_start, front.facing_ex});
+    if (already)
+        return;
+    ts->IncrementTrainOccupation();   //Will not work in V1;  to hell with V1.
 }
 
-
-void Train::SetUnoccupied (TrackUnit * ts) {
-    if (Occupied.count(ts)) {
-        Occupied.erase(ts);
+/* The back has left the first count segs of Occupied. */
+void Train::VacateRear (size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        TrackUnit * ts = Occupied[i].ts;
+        if (OccupiesP(ts, i + 1))
+            continue;
         ts->DecrementTrainOccupation();
     }
-}
-
-
-void Train::SetOccupied (TrackUnit * ts) {
-    if (Occupied.count(front.ts))
-        return;
-
-    Occupied.insert(ts);
-    ts->IncrementTrainOccupation();   //Will not work in V1;  to hell with V1.
+    Occupied.erase(Occupied.begin(), Occupied.begin() + count);
 }
 
 void Train::vanish() {
@@ -555,21 +666,121 @@ void Train::vanish() {
 Train::~Train () {
     if (CV_TrainID == id)
 	CV_TrainID = 0;
-    for (auto ts : Occupied)
-        ts->DecrementTrainOccupation();
+    VacateRear(Occupied.size());
     if (NextSig != NULL)
 	NextSig->Hook (NULL);
-    KillTimer();
-    DestroyWindow (Dialog);
+    StopStepping();
+    if (Dialog)
+        DestroyWindow (Dialog);
     FreedTrainNumbers.push_back(id);
     //Don't erase from STL map!  that's the only way we could have gotten here!
 }
 
-void Train::KillTimer() {
-    KillOneTimer (this);
-    TimerPending = false;
+/* Snapshot and rewind (Snapshot.hpp).  Each train is saved whole, front
+   first, so that a train that has vanished since can be made again at its
+   front before the rest is put back.  The occupied segs are the train's own
+   record of its body. */
+
+void SnapshotTrains (SnapshotWriter& w) {
+    w.Put(Trains.size());
+    for (auto& pair : Trains)
+        w.Put(pair.first);
+    for (auto& pair : Trains)
+        pair.second->SaveState(w);
+}
+
+void Train::SaveState (SnapshotWriter& w) {
+    w.Put(id);
+    w.Put(Dialog == NULL);
+    w.Put(front);
+    w.Put(back);
+    w.Put(observant);
+    w.Put(Speed);
+    w.Put(Cruise);
+    w.Put(Length);
+    w.Put(LastTargetSpeed);
+    w.Put((long)(NXTimerNow() - Time));
+    w.Put(NextSig);
+    w.Put(X_Of_Next_Signal);
+    w.Put(LostMS);
+    w.Put(CODisplay);
+    w.Put(StepSlot >= 0);
+    w.Put(Occupied.size());
+    for (auto& seg : Occupied)
+        w.Put(seg);
+}
+
+void RestoreTrains (SnapshotReader& r) {
+    if (Stepping)               /* a pass abandoned to a relay race handler */
+        Train::CompactMoving();
+    size_t n = r.Get<size_t>();
+    std::vector<int> ids;
+    for (size_t i = 0; i < n; i++)
+        ids.push_back(r.Get<int>());
+    for (auto it = Trains.begin(); it != Trains.end(); )
+        if (std::find(ids.begin(), ids.end(), it->first) == ids.end())
+            it = Trains.erase(it);
+        else
+            ++it;
+    for (size_t i = 0; i < n; i++) {
+        int id = r.Get<int>();
+        bool headless = r.Get<bool>();
+        Pointpos front = r.Get<Pointpos>();
+        if (Trains.count(id) == 0) {
+            auto freed = std::find(FreedTrainNumbers.begin(), FreedTrainNumbers.end(), id);
+            if (freed != FreedTrainNumbers.end())
+                FreedTrainNumbers.erase(freed);
+            MakeTrainN(id, front.ts, TRAIN_CTL_HALTED | (headless ? TRAIN_CTL_HEADLESS : 0));
+        }
+        Trains[id]->RestoreState(front, r);
+    }
 }
 
+void Train::RestoreState (const Pointpos& saved_front, SnapshotReader& r) {
+    back = r.Get<Pointpos>();
+    observant = r.Get<bool>();
+    Speed = r.Get<double>();
+    Cruise = r.Get<double>();
+    Length = r.Get<double>();
+    LastTargetSpeed = r.Get<double>();
+    long age = r.Get<long>();
+    Signal * next_sig = r.Get<Signal*>();
+    X_Of_Next_Signal = r.Get<double>();
+    LostMS = r.Get<double>();
+    CODisplay = r.Get<bool>();
+    bool moving = r.Get<bool>();
+    std::vector<OccupiedSeg> occupied(r.Get<size_t>());
+    for (auto& seg : occupied)
+        seg = r.Get<OccupiedSeg>();
+
+    /* The new body is taken up before the old is let go, so circuits held
+       by both don't blink clear in between. */
+    for (size_t i = 0; i < occupied.size(); i++)
+        if (std::none_of(occupied.begin(), occupied.begin() + i,
+                         [&](const OccupiedSeg& o) {return o.ts == occupied[i].ts;}))
+            occupied[i].ts->IncrementTrainOccupation();
+    VacateRear(Occupied.size());
+    Occupied.swap(occupied);
+
+    front = saved_front;
+    front.Trn = back.Trn = this;
+    Time = NXTimerNow() - age;
+
+    if (next_sig != NextSig) {
+        if (NextSig != NULL)
+            NextSig->Hook (NULL);
+        if (next_sig != NULL)
+            next_sig->Hook (this);
+        NextSig = next_sig;
+    }
+    if (moving)
+        StartStepping();
+    else
+        StopStepping();
+    UpdateSwitches();
+    UpdatePositionReport();
+    CheckHalted();
+}
 
 void Train::Reverse (){
 
@@ -579,6 +790,7 @@ void Train::Reverse (){
     back.IAmFront = FALSE;
     front.Reverse(0.0f);
     back.Reverse(front.x - Length/100.0);
+    ReverseOccupations();
 
     InitPosition();
 
@@ -673,7 +885,7 @@ void Train::ExplicitSpeed (double speed) {
     CheckHalted();
 
     if (Speed == 0.0 && was_speed != 0.0)
-	KillTimer();
+	StopStepping();
     if (was_speed == 0.0 && Speed != 0.0)
 	ComputeNextMotion();		/* must be LAST CALL */
 }
@@ -700,7 +912,7 @@ int Train::ScrollHandler (WPARAM scrollcode, WORD nPos) {
 }
 
 BOOL  Train::ShowWindowIfOwnTU (TrackUnit * tu) {
-    if (Occupied.count(tu)) {
+    if (Dialog && OccupiesP(tu)) {
         ShowWindow(Dialog, SW_RESTORE);
         SetFocus(Dialog);
         return TRUE;
@@ -713,13 +925,15 @@ void Train::SetSpeed (double spd) {
 	spd = 0.0;
     Speed = spd;
     if (Speed == 0.0)
-	KillTimer();
+	StopStepping();
     CheckHalted();
     UpdatePositionReport();
 }
 
 void Train::CheckHalted() {
 #if! NXSYSMac // maybe pretty up later
+    if (Dialog == NULL)
+        return;
     HWND reverser = GetDlgItem (Dialog, TRD_REV);
     EnableWindow (reverser, (Speed == 0.0));
 #endif
@@ -732,6 +946,8 @@ void TrainMiscCtl (int cmd) {
     }
     else {
         for (auto& it : Trains) {
+            if (it.second->Dialog == NULL && cmd != CmHaltTrains)
+                continue;
             switch (cmd) {
                 case CmHaltTrains:
                     it.second->SetSpeed (0.0);
@@ -851,7 +1067,7 @@ int FilterTrainDialogMessages(MSG* mp) {
         if (IsDialogMessage(ChooseTrackDlg, mp))
             return 1;
     for (decltype(Trains.begin()) it = Trains.begin(); it != Trains.end(); it++) {
-        if (IsDialogMessage((it->second)->Dialog, mp))
+        if ((it->second)->Dialog && IsDialogMessage((it->second)->Dialog, mp))
             return 1;
     }
     return 0;
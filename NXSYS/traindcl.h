@@ -2,10 +2,12 @@
 #define _NXSYS_TRAIN_SYSTEM_INTERNAL_HEADER_H__
 
 
-#include <set>
+#include <vector>
 
 typedef TrackSeg TrackUnit;
 class Train;
+class SnapshotWriter;
+class SnapshotReader;
 
 struct _Pointpos {
     TrackSeg * ts;
@@ -33,6 +35,15 @@ struct _Pointpos {
 
 typedef struct _Pointpos Pointpos;
 
+/* A track seg the train occupies, with the x at which the front entered it.
+   Kept from back to front, this is the train's own linear reference; the back
+   always follows exactly where the front went. */
+struct OccupiedSeg {
+    TrackSeg * ts;
+    double x_at_seg_start;
+    TSEX facing_ex;
+};
+
 class Train {
 
 
@@ -47,7 +58,7 @@ public:
 
 
 private:
-    bool        TimerPending;
+    int         StepSlot;               // index in the train stepper's Moving list, or -1
 
     bool	observant;
 
@@ -59,8 +70,9 @@ private:
     double	LastTargetSpeed;
     long	Time;
     Signal*	NextSig;
-    std::set<TrackSeg*> Occupied;
+    std::vector<OccupiedSeg> Occupied;
     double	X_Of_Next_Signal;
+    double	LostMS;                 // time lost to signals against cruising, for capacity simulation
     
     bool    CODisplay;
 
@@ -70,6 +82,9 @@ private:
     Signal *FindNextSig();
     void    InstallNextSig();
     int     ComputeOccupations();
+    void    ReverseOccupations();
+    bool    OccupiesP(TrackUnit * ts, size_t from = 0);
+    void    VacateRear(size_t count);
     void    StringFld (int id, const char* text);
     void    StringFld (int id, const std::string& str);
     void    StringFldF(int id, const char* fmt, ...);
@@ -77,7 +92,7 @@ private:
     void    ComputeWindowPlacement();
     void    ComputeNextMotion();
     void    Observance();
-    void    SetTimer(), KillTimer();
+    void    StartStepping(), StopStepping();
     void    CheckHalted();
     void    Reverse();
     void    InitPosition();
@@ -94,18 +109,19 @@ public:
     double  GetSpeed() {return Speed;}
     BOOL    ShowWindowIfOwnTU (TrackUnit * tu);
     double  GetCruise() {return Cruise;}
-    void    TimerHandler();
 
 #ifdef NXOGL
     void    SetCabviewCheck (BOOL v);
 #endif
     void    SetOccupied (TrackUnit * ts);
-    void    SetUnoccupied (TrackUnit * ts);
 
     void    MaybeNoticeSignalChange (Signal * g);
+    void    SaveState (SnapshotWriter& w);
+    void    RestoreState (const Pointpos& front, SnapshotReader& r);
             ~Train();
 
-static void StaticTimerHandler(void *);
+static void StepAllTrains(void *);
+static void CompactMoving();
 
 };
 
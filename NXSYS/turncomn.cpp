@@ -11,6 +11,7 @@
 #include "rlyapi.h"
 #include "xtgtrack.h"
 #include "xturnout.h"
+#include "traincfg.h"
 
 const int SwitchMoveTimeMS = 1800;
 
@@ -107,11 +108,13 @@ void Turnout::Timer () {
     if (CLKCodingPhase == 0)
 	KillOneCoder (this);
     Thrown = !Thrown;
+    InvalidateTrainLookahead(this);
 
     if ((Thrown && RelayState(NWZ)) || (!Thrown && RelayState(RWZ)))
 	StartMove();
     else {
 	ReportToRelay (Thrown ? RWP : NWP, TRUE);
+	InvalidationBatch batch;
 	UpdateRoutings();
 	InvalidateAndTurnouts();
     }
@@ -6,9 +6,11 @@
 #include "xtgtrack.h"
 #include "math.h"
 #include <unordered_set>
+#include <algorithm>
 #include <cassert>
 
 #include <vector>   // Vectorized for global array and local segs 9/27/2019
+#include <memory>
 
 #if TLEDIT
 #include "undo.h"
@@ -27,10 +29,16 @@
  */
 
 static std::vector<TrackCircuit*> AllTrackCircuits;
+#ifdef REALLY_NXSYS
+static bool ReportsDeferred = false;
+static std::vector<TrackCircuit*> PendingReports;
+#endif
 
 TrackCircuit::TrackCircuit (IJID sno) {
     assert(sno && "Attempt to create track circuit 0");
     Occupied = Routed = Coding = FALSE;
+    ReportPending = FALSE;
+    TrainCount = 0;
     TrackRelay = NULL;
     StationNo = sno;
 };
@@ -172,8 +180,14 @@ void TrackCircuit::SetOccupied (BOOL sta, BOOL force) {
 	Occupied = sta;
 	Invalidate();
 #ifdef REALLY_NXSYS
-	if (TrackRelay)
-	    ReportToRelay (TrackRelay, !Occupied);
+	if (TrackRelay) {
+	    if (!ReportsDeferred)
+		ReportToRelay (TrackRelay, !Occupied);
+	    else if (!ReportPending) {
+		ReportPending = TRUE;
+		PendingReports.push_back(this);
+	    }
+	}
 #endif
     }
 }
@@ -227,6 +241,39 @@ void TrackCircuitSystemReInit() {
     for (auto ttc : Circuits)
         delete ttc;
     AllTrackCircuits.clear();
+    PendingReports.clear();
+    ReportsDeferred = false;
+}
+
+void DeferTrackCircuitReports () {
+    ReportsDeferred = true;
+}
+
+/* For when the track relays are being set some other way. */
+void DiscardTrackCircuitReports () {
+    ReportsDeferred = false;
+    for (auto tc : PendingReports)
+        tc->ReportPending = FALSE;
+    PendingReports.clear();
+}
+
+/* A circuit that went occupied and clear again since the deferral reports its
+   final state, which the relay already has, so nothing happens. */
+void FlushTrackCircuitReports () {
+    ReportsDeferred = false;
+    int n = (int)PendingReports.size();
+    if (n == 0)
+        return;
+    std::vector<Relay*> relays(n);
+    std::unique_ptr<BOOL[]> states(new BOOL[n]);
+    for (int i = 0; i < n; i++) {
+        TrackCircuit * tc = PendingReports[i];
+        tc->ReportPending = FALSE;
+        relays[i] = tc->TrackRelay;
+        states[i] = !tc->Occupied;
+    }
+    PendingReports.clear();
+    ReportToRelays (relays.data(), states.get(), n);
 }
 
 void TrackCircuit::TrackReportFcn(BOOL state, void* v) {
@@ -240,20 +287,22 @@ void TrackCircuit::TrackKRptFcn(BOOL state, void* v) {
 }
 
 
-void TrackCircuit::ComputeSwitchRoutedState () {
-    /* route all segments that have both ends clear to an IJ with
-       no trailed trailing point switches */
-
-    for (auto ts : Segments)
-	ts->ComputeSwitchRoutedState ();
-}
-
-void TrackSeg::ComputeSwitchRoutedState () {
-    BOOL oldstate = Routed;
-    Routed = ComputeSwitchRoutedEndState(0)
-	     && ComputeSwitchRoutedEndState(1);
-    if (oldstate != Routed)
+/* A segment is routed if both its ends are clear to an IJ with no trailed
+   trailing point switches.  Each end's state is kept in RoutedEnds, and is
+   recomputed only when a switch its walk can reach moves (see
+   Turnout::UpdateRoutings); an end that reaches no switch is always routed. */
+
+void TrackSeg::UpdateSwitchRoutedEnd (int ex) {
+    unsigned char bit = (unsigned char)(1 << ex);
+    if (ComputeSwitchRoutedEndState(ex))
+	RoutedEnds |= bit;
+    else
+	RoutedEnds &= ~bit;
+    BOOL routed = (RoutedEnds == 3);
+    if (routed != Routed) {
+	Routed = routed;
 	Invalidate();
+    }
 }
 
 BOOL TrackSeg::ComputeSwitchRoutedEndState(int ex) {
@@ -292,6 +341,29 @@ next:
     }
 }
 
+/* Whether ComputeSwitchRoutedEndState(ex) can, in any position of the
+   switches on the way, look at tn. */
+BOOL TrackSeg::SwitchRoutedEndReaches (int ex, Turnout * tn, std::vector<TrackSegEnd*>& seen) {
+    TrackSegEnd * ep = &Ends[ex];
+    if (std::find(seen.begin(), seen.end(), ep) != seen.end())
+	return FALSE;			/* a loop */
+    seen.push_back(ep);
+    if (ep->InsulatedP() || ep->Next == NULL)
+	return FALSE;
+    TrackJoint * tj = ep->Joint;
+    if (tj != NULL) {
+	if (tj->TSCount < 3 || tj->TurnOut == NULL)
+	    return FALSE;
+	if (tj->TurnOut == tn)
+	    return TRUE;
+	if (this != (*tj)[TSAX::REVERSE] && this != (*tj)[TSAX::NORMAL]
+	    && ep->NextIfSwitchThrown
+	         ->SwitchRoutedEndReaches(1-(int)ep->EndIndexReverse, tn, seen))
+	    return TRUE;
+    }
+    return ep->Next->SwitchRoutedEndReaches(1-(int)ep->EndIndexNormal, tn, seen);
+}
+
 GraphicObject * FindDemoHitCircuit (long id) {
     TrackCircuit * tc = FindTrackCircuit (id);
     if (tc == NULL)
@@ -308,10 +380,7 @@ TrackSeg * TrackCircuit::FindDemoHitSeg() {
 }
 
 void TrackCircuit::ComputeOccupiedFromTrains () {
-    int occ = 0;
-    for (auto ts : Segments)
-	occ += ts->TrainCount;
-    SetOccupied ((BOOL)(occ != 0));
+    SetOccupied ((BOOL)(TrainCount != 0));
 }
 
 
@@ -44,6 +44,9 @@ TrackSegEnd::TrackSegEnd() {
 #ifdef REALLY_NXSYS
     Next = NextIfSwitchThrown = NULL;
     FacingSwitch = NULL;
+    NextSignal = NULL;
+    NextSignalDistance = 0.0;
+    LookaheadState = LOOKAHEAD::INVALID;
 #endif
     SignalProtectingEntrance = NULL;
     ExLight = NULL;
@@ -57,6 +60,7 @@ TrackSeg::TrackSeg (WP_cord wpx1, WP_cord wpy1, WP_cord wpx2, WP_cord wpy2){
     Routed = TRUE;
     TrainCount = 0;
 #ifdef REALLY_NXSYS
+    RoutedEnds = 3;
     OwningTurnout = NULL;
     RWLength = -1.0f;			/* "not computed" */
 #else
@@ -203,20 +207,7 @@ void TrackSeg::DisplayInState (HDC dc, int control) {
     MoveTo (dc, scx1, scy1);
     LineTo (dc, scx2, scy2);
     
-    HPEN pen;
-    if (!Routed || !Circuit)
-	pen = NULL;
-    else if (Circuit->Occupied)
-	pen = TrackOccupiedPen;
-    else if (Circuit->Routed)
-	pen = TrackRoutedPen;
-#ifdef REALLY_NXSYS
-    else if (OwningTurnout && OwningTurnout->Thrown)
-	pen = TrackDftPenThrown;
-#endif
-    else 
-	pen = NULL;
-
+    HPEN pen = IndicationPen();
     if (pen) {
 	double  incXSegLen = Track_Seg_Len*CosTheta*NXGO_Scale,
 	    incYSegLen = Track_Seg_Len*SinTheta*NXGO_Scale,
@@ -245,6 +236,35 @@ void TrackSeg::DisplayInState (HDC dc, int control) {
 	Ends[1].ExLight->Display(dc);
 }
 
+/* Zoomed out the blips would run together; the lit part is the whole
+   segment. */
+void TrackSeg::DisplayOverview (HDC dc, OverviewLayer layer) {
+    HPEN pen = (layer == OverviewLayer::Track) ? TrackPen : IndicationPen();
+    if (pen == NULL)
+	return;
+    int scx1, scy1, scx2, scy2;
+    GetGraphicsCoords(0, scx1, scy1);
+    GetGraphicsCoords(1, scx2, scy2);
+    SelectObject (dc, pen);
+    MoveTo (dc, scx1, scy1);
+    LineTo (dc, scx2, scy2);
+}
+
+/* The pen the segment's blips are lit in, NULL if dark. */
+HPEN TrackSeg::IndicationPen () {
+    if (!Routed || !Circuit)
+	return NULL;
+    else if (Circuit->Occupied)
+	return TrackOccupiedPen;
+    else if (Circuit->Routed)
+	return TrackRoutedPen;
+#ifdef REALLY_NXSYS
+    else if (OwningTurnout && OwningTurnout->Thrown)
+	return TrackDftPenThrown;
+#endif
+    else 
+	return NULL;
+}
 
 void TrackSeg::Split (WP_cord wpx1, WP_cord wpy1, TrackJoint * tj, TrackSeg* new_seg) {
  
@@ -523,12 +543,16 @@ void TrackSeg::UpdateCircuitOccupation(){
 
 void TrackSeg::IncrementTrainOccupation() {
     TrainCount += 1;
+    if (Circuit)
+        Circuit->TrainCount += 1;
     UpdateCircuitOccupation();
 }
 
 void TrackSeg::DecrementTrainOccupation(){
     assert (TrainCount);
     TrainCount -= 1;
+    if (Circuit)
+        Circuit->TrainCount -= 1;
     UpdateCircuitOccupation();
 }
 #endif
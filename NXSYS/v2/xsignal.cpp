@@ -155,6 +155,18 @@ void PanelSignal::Display (HDC dc) {
 #endif
 }
 
+/* Zoomed out, only the aspect: the head, without stem or fleeting. */
+void PanelSignal::DisplayOverview (HDC dc, OverviewLayer layer) {
+    if (layer != OverviewLayer::Indications)
+	return;
+    int ra = (int)(Radius*NXGO_Scale);
+    if (ra < 2)
+	ra = 2;
+    SelectObject (dc, GetStockObject(NULL_PEN));
+    SelectObject (dc, Sig->GetGKBrush());
+    Ellipse (dc, sc_x - ra, sc_y - ra, sc_x + ra, sc_y + ra);
+}
+
 #ifndef TLEDIT
 void PanelSignal::DrawFleeting (HDC dc, BOOL enabled) {
     //int bu = (int)(.75*Radius);
@@ -193,6 +193,8 @@ class TrackJoint
 class TrackCircuit {		// no longer graphic object
     public:
 	BOOL  Occupied, Routed, Coding;
+	BOOL  ReportPending;     // relay report deferred to FlushTrackCircuitReports
+	int   TrainCount;        // sum of its segs' TrainCounts
 	Relay* TrackRelay;
         std::vector<TrackSeg*>Segments;
 	IJID StationNo;
@@ -208,7 +210,6 @@ class TrackCircuit {		// no longer graphic object
 	
 #ifdef REALLY_NXSYS
 	void ComputeOccupiedFromTrains();
-	void ComputeSwitchRoutedState ();
 	TrackSeg * FindDemoHitSeg();
 	static void TrackReportFcn(BOOL state, void* v);
 	static void TrackKRptFcn(BOOL state, void* v);
@@ -219,6 +220,13 @@ class TrackCircuit {		// no longer graphic object
 };
 
 
+/* State of a track seg end's cached train lookahead (see xtrains.cpp) */
+enum class LOOKAHEAD : char {
+    INVALID = 0,
+    WALKING = 1,
+    VALID = 2
+};
+
 class TrackSegEnd {			//NOT a graphic object
     public:
 	WP_cord wpx, wpy;      //Windows (all-scrolled-out) Panel coord
@@ -226,6 +234,10 @@ class TrackSegEnd {			//NOT a graphic object
 	TrackSeg *Next;   //if there is a switch, "normal" next
 	TrackSeg *NextIfSwitchThrown; // "reverse" next, if switch...
 	Turnout *FacingSwitch; 
+	/* Next signal facing this end, and distance to it from seg start */
+	Signal * NextSignal;
+	double NextSignalDistance;
+	LOOKAHEAD LookaheadState;
 #endif
 	Signal * SignalProtectingEntrance; //Train sys uses this for instruc
 	TSEX EndIndexNormal, EndIndexReverse;
@@ -257,12 +269,14 @@ public:
     BOOL    Marked;
     int     Clock;
 #else
+    unsigned char RoutedEnds;  // bit per end routed; Routed is both
     Turnout *OwningTurnout;
     float   RWLength;  /* real-world length for train sys */
 #endif
 	short TrainCount;
 	short GraphicBlips;
 	void DisplayInState (HDC dc, int state);
+	HPEN IndicationPen ();
 	BOOL SnapIntoLine (WP_cord& wpx, WP_cord& wpy);
 	TrackJoint * FindOtherJoint (TrackJoint * tj);
 	void Align(WP_cord wpx1, WP_cord wpy1, WP_cord wpx2, WP_cord wpy2);
@@ -271,6 +285,7 @@ public:
 	~TrackSeg();
 
 	virtual void Display (HDC dc);
+	virtual void DisplayOverview (HDC dc, OverviewLayer layer);
 	virtual TypeId TypeID ();
 	virtual bool IsNomenclature(IJID);
 	TrackCircuit* SetTrackCircuit (IJID ID);
@@ -314,8 +329,9 @@ public:
 	void SpreadSwitchRoutingState(BOOL p_routed);
 	void SpreadRWFactor (double rwf);
 	void ProcessLoadComplete();
-	void ComputeSwitchRoutedState();
+	void UpdateSwitchRoutedEnd(int ex);
 	BOOL ComputeSwitchRoutedEndState(int ex);
+	BOOL SwitchRoutedEndReaches(int ex, Turnout * tn, std::vector<TrackSegEnd*>& seen);
 	int  StationPointsEnd (WP_cord &wpcordlen, TSEX end_index, int loop_check);
 	virtual void EditContextMenu(HMENU m);
 
@@ -369,6 +385,7 @@ class PanelSignal  : public GraphicObject, public PropEditor<PanelSignal> {
 	void DrawFleeting(HDC dc, BOOL enabled);
 #endif
 	virtual void Display (HDC dc);
+	virtual void DisplayOverview (HDC dc, OverviewLayer layer);
 	void Reposition();
 	virtual TypeId TypeID ();
 	virtual bool IsNomenclature(IJID);
@@ -502,6 +519,11 @@ extern BOOL ShowNonselectedJoints;
 #ifdef REALLY_NXSYS
 void TrackCircuitSystemLoadTimeComplete();
 void TrackCircuitSystemReInit();
+/* Between these, track relays are told of circuit changes only at the flush,
+   once per circuit, all in one relay propagation. */
+void DeferTrackCircuitReports();
+void FlushTrackCircuitReports();
+void DiscardTrackCircuitReports();
 void DecodeDigitated (IJID input, int &trackno, int &sno);
 TrackCircuit * FindTrackCircuit (long sno);
 void TrackCircuitSystemReInit();
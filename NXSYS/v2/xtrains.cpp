@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <math.h>
 #include <cassert>
+#include <vector>
+#include <algorithm>
 
 #include "xtgtrack.h"
 #include "lyglobal.h"
@@ -72,23 +74,25 @@ static int SULTMMapper2 (GraphicObject * g) {
 }
 
 
-/* delay until first train ?  */
-void SetUpLayoutTrainMetrics () {
-    MapGraphicObjectsOfType (TypeId::TRACKSEG, SULTMMapper1);
-    MapGraphicObjectsOfType (TypeId::TRACKSEG, SULTMMapper2);
-}
-
-
-Signal * Train::FindNextSig () {
-    front.FindTrackSeg();
-    X_Of_Next_Signal = front.x_at_seg_start;
-    TrackSeg * ts = front.ts;
-    TSEX endx = front.facing_ex;
-    while (ts) {
+/* Next-signal lookahead.  Each track seg end, read as "a train facing that
+   end", caches the next signal such a train will come to, and the distance to
+   it from the start of the seg, so FindNextSig need not walk the track on every
+   tick.  The table is filled at load; a switch throw invalidates only the
+   entries whose lookahead passed through its points, and they are recomputed
+   when next asked for. */
+
+static void ComputeLookahead (TrackSeg * ts, TSEX endx) {
+    /* Walk to a signal, end of track, or an entry already known, then fill
+       in the entries passed, last first. */
+    std::vector<std::pair<TrackSeg*, TrackSegEnd*>> path;
+    Signal * sig = NULL;
+    double dist = 0.0;
+    for (;;) {
         TrackSegEnd * ep = &ts->GetEnd(endx);
-	X_Of_Next_Signal += ts->RWLength;
+        ep->LookaheadState = LOOKAHEAD::WALKING;
+        path.emplace_back(ts, ep);
 	if (ep->Next == NULL)
-	    return NULL;
+	    break;
 	if (ep->FacingSwitch == NULL || !ep->FacingSwitch->Thrown) {
 	    ts = ep->Next;
             endx = flip_end(ep->EndIndexNormal);
@@ -97,11 +101,85 @@ Signal * Train::FindNextSig () {
 	    ts = ep->NextIfSwitchThrown;
             endx = flip_end(ep->EndIndexReverse);
 	}
-	Signal * s = ts->GetOtherEnd(endx).SignalProtectingEntrance;
-	if (s)
-	    return s;
+        sig = ts->GetOtherEnd(endx).SignalProtectingEntrance;
+        if (sig)
+            break;
+        TrackSegEnd& next = ts->GetEnd(endx);
+        if (next.LookaheadState == LOOKAHEAD::VALID) {
+            sig = next.NextSignal;
+            dist = next.NextSignalDistance;
+            break;
+        }
+        if (next.LookaheadState == LOOKAHEAD::WALKING)
+            break;    /* unsignalled loop */
+    }
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+        dist += it->first->RWLength;
+        it->second->NextSignal = sig;
+        it->second->NextSignalDistance = dist;
+        it->second->LookaheadState = LOOKAHEAD::VALID;
     }
-    return NULL;
+}
+
+static int SULTMMapper4 (GraphicObject * g) {
+    TrackSeg* ts = (TrackSeg *) g;
+    for (TSEX endx : {TSEX::E0, TSEX::E1})
+        if (ts->GetEnd(endx).LookaheadState != LOOKAHEAD::VALID)
+            ComputeLookahead(ts, endx);
+    return 0;
+}
+
+/* Invalidate every entry whose lookahead runs through that of ts facing endx.
+   Trains get there through the other end of ts, unless a signal there ends
+   their lookahead first. */
+static void InvalidateLookahead (TrackSeg * ts, TSEX endx) {
+    std::vector<std::pair<TrackSeg*, TSEX>> work {{ts, endx}};
+    while (work.size()) {
+        ts = work.back().first;
+        endx = work.back().second;
+        work.pop_back();
+        TrackSegEnd& E = ts->GetEnd(endx);
+        if (E.LookaheadState != LOOKAHEAD::VALID)
+            continue;
+        E.LookaheadState = LOOKAHEAD::INVALID;
+        TrackSegEnd& entrance = ts->GetOtherEnd(endx);
+        if (entrance.SignalProtectingEntrance)
+            continue;
+        if (entrance.Next)
+            work.emplace_back(entrance.Next, entrance.EndIndexNormal);
+        if (entrance.NextIfSwitchThrown)
+            work.emplace_back(entrance.NextIfSwitchThrown, entrance.EndIndexReverse);
+    }
+}
+
+void InvalidateTrainLookahead (Turnout * tn) {
+    for (int i = 0; i < tn->NEnds; i++) {
+        TrackJoint * tj = tn->Joints[i];
+        if (tj == NULL)
+            continue;
+        TrackSeg * stem = (*tj)[TSAX::STEM];
+        InvalidateLookahead(stem, stem->FindEndIndex(tj));
+    }
+}
+
+/* delay until first train ?  */
+void SetUpLayoutTrainMetrics () {
+    MapGraphicObjectsOfType (TypeId::TRACKSEG, SULTMMapper1);
+    MapGraphicObjectsOfType (TypeId::TRACKSEG, SULTMMapper2);
+    MapGraphicObjectsOfType (TypeId::TRACKSEG, SULTMMapper4);
+}
+
+
+Signal * Train::FindNextSig () {
+    front.FindTrackSeg();
+    X_Of_Next_Signal = front.x_at_seg_start;
+    if (front.ts == NULL)
+        return NULL;
+    TrackSegEnd& E = front.ts->GetEnd(front.facing_ex);
+    if (E.LookaheadState != LOOKAHEAD::VALID)
+        ComputeLookahead(front.ts, front.facing_ex);
+    X_Of_Next_Signal += E.NextSignalDistance;
+    return E.NextSignal;
 }
 
 
@@ -172,8 +250,6 @@ int Pointpos::FindTrackSeg () {
 	    }
 	    feet_left = segfeet;
 	    /* must move into next track segment */
-	    if (!IAmFront)
-		Trn->SetUnoccupied (ts);
             TrackSegEnd * ep = &ts->GetEnd(facing_ex);
 
 	    if (ep->Joint && ep->Joint->Insulated && ep->Joint->Nomenclature){
@@ -208,19 +284,44 @@ int Pointpos::FindTrackSeg () {
 }
 
 
+/* Only the front walks the track; the back is found in Occupied by binary
+   search on x, and everything behind it is vacated in one go. */
 int Train::ComputeOccupations() {
     
     front.FindTrackSeg();
     back.x = front.x - Length/100.0;
-    if (back.x >= 0.0) {
-	if (back.FindTrackSeg() < 0) {
-	    /* train has run off map */
-	    return 0;
-	}
+    auto it = std::upper_bound(Occupied.begin(), Occupied.end(), back.x,
+                               [](double x, const OccupiedSeg& o) {
+                                   return x < o.x_at_seg_start;
+                               });
+    if (it != Occupied.begin())
+        --it;			/* else back still short of the track */
+    if (it + 1 == Occupied.end()
+        && back.x - it->x_at_seg_start >= it->ts->RWLength) {
+        /* train has run off map */
+        return 0;
     }
+    VacateRear(it - Occupied.begin());
+    back.ts = Occupied[0].ts;
+    back.x_at_seg_start = Occupied[0].x_at_seg_start;
+    back.facing_ex = Occupied[0].facing_ex;
     return 1;
 }
 
+/* After front and back have been swapped and reversed, re-express Occupied
+   from the new back to the new front, in the new front's measure. */
+void Train::ReverseOccupations() {
+    std::reverse(Occupied.begin(), Occupied.end());
+    size_t last = Occupied.size() - 1;
+    Occupied[last].x_at_seg_start = front.x_at_seg_start;
+    Occupied[last].facing_ex = front.facing_ex;
+    for (size_t i = last; i > 0; i--) {
+        OccupiedSeg& o = Occupied[i - 1];
+        o.x_at_seg_start = Occupied[i].x_at_seg_start - o.ts->RWLength;
+        o.facing_ex = flip_end(o.facing_ex);
+    }
+}
+
 static int FTETSBNMapper (GraphicObject * g, void * v) {
     TrackSeg * ts = (TrackSeg *) g;
     long id = *(long *) v;
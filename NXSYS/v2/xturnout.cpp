@@ -6,6 +6,7 @@
 #include "timers.h"
 #include <math.h>
 #include <cassert>
+#include <algorithm>
 
 #include "typeid.h"
 
@@ -16,6 +17,8 @@
 #include "resource.h"
 #include "rlymenu.h"
 #include "nxsysapp.h"
+#include "traincfg.h"
+#include "Snapshot.hpp"
 #endif
 
 static Turnout** AllTurnouts = NULL;
@@ -33,6 +36,7 @@ Turnout::Turnout (int xno) {
     AuxKeyForce = 0;
     Joints[0] = NULL;
     Joints[1] = NULL;
+    RoutingDependentsKnown = false;
     for (int i = 0; i < 2; i++)
 	for (int j = 0; j < 2; j++){
 	    NK[i][j].ExLight = NULL;
@@ -238,13 +242,33 @@ void Turnout::Hit (int mousewhat, TrackSeg* ht) {
 #endif
 }
 
-void Turnout::UpdateRoutings () {
+void Turnout::FindRoutingDependents () {
+    RoutingDependents.clear();
     for (int i = 0; i < NEnds; i++) {
 	TrackJoint * tj = Joints[i];
 	TrackCircuit * circuit = (*tj)[TSAX::STEM]->Circuit;
-	if (circuit && circuit->MultipleSegmentsP())
-	    circuit->ComputeSwitchRoutedState();
+	if (circuit == NULL || !circuit->MultipleSegmentsP())
+	    continue;
+	for (auto ts : circuit->Segments)
+	    for (int ex = 0; ex < 2; ex++) {
+		std::vector<TrackSegEnd*> seen;
+		if (ts->SwitchRoutedEndReaches(ex, this, seen)
+		    && std::find(RoutingDependents.begin(), RoutingDependents.end(),
+				 std::make_pair(ts, ex)) == RoutingDependents.end())
+		    RoutingDependents.emplace_back(ts, ex);
+	    }
     }
+    RoutingDependentsKnown = true;
+}
+
+/* Only the seg ends whose routing can see this switch are looked at, and
+   what they redraw is repainted at once. */
+void Turnout::UpdateRoutings () {
+    if (!RoutingDependentsKnown)
+	FindRoutingDependents();
+    InvalidationBatch batch;
+    for (auto& dep : RoutingDependents)
+	dep.first->UpdateSwitchRoutedEnd(dep.second);
 }
 
 #ifdef REALLY_NXSYS
@@ -269,6 +293,34 @@ TrackSeg * Turnout::GetOwningSeg() {
     return (*tj)[TSAX::REVERSE];
 }
 
+/* A moving switch's timer and coder are restored by the timer and coder
+   systems. */
+void SnapshotTurnouts (SnapshotWriter& w) {
+    for (int i = 0; i < NTurnouts; i++) {
+	Turnout * tn = AllTurnouts[i];
+	w.Put(tn->Thrown);
+	w.Put(tn->MovingPhase);
+	w.Put(tn->CLKCodingPhase);
+	w.Put(tn->CLK_Coding);
+    }
+}
+
+void RestoreTurnouts (SnapshotReader& r) {
+    for (int i = 0; i < NTurnouts; i++) {
+	Turnout * tn = AllTurnouts[i];
+	char thrown = r.Get<char>();
+	tn->MovingPhase = r.Get<char>();
+	tn->CLKCodingPhase = r.Get<char>();
+	tn->CLK_Coding = r.Get<char>();
+	if (thrown != tn->Thrown) {
+	    tn->Thrown = thrown;
+	    InvalidateTrainLookahead(tn);
+	    tn->UpdateRoutings();
+	}
+	tn->InvalidateAndTurnouts();
+    }
+}
+
 
 #endif
 
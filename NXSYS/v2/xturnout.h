@@ -44,6 +44,11 @@ public:
     TrackJoint * Joints[2];
     NKData NK[2][2];
 
+    /* Seg ends whose routed state can depend on this switch, found at the
+       first UpdateRoutings. */
+    std::vector<std::pair<TrackSeg*, int>> RoutingDependents;
+    bool RoutingDependentsKnown;
+
 public:
     long MoveStartTime;
     char MovingPhase;
@@ -64,6 +69,7 @@ public:
     int  AssignJoint (TrackJoint* tj);
     void SegConflict (Turnout* other_tn);
     void UpdateRoutings();
+    void FindRoutingDependents();
     void EditContextMenu(HMENU m);
     TrackSeg * GetOwningSeg();
 
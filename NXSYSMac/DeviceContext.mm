@@ -14,6 +14,7 @@
 #include <vector>
 #include <string>
 #include "WinMacCalls.h"
+#include "OffscreenRaster.hpp"
 
 static std::vector<LOGFONT> fonts;
 
@@ -45,6 +46,7 @@ struct __DC_ {
     int movedX;
     int movedY;
     BOOL originKnown;
+    OffscreenRaster * raster = NULL;    /* drawing off the screen, into this, if not NULL */
     
     
     __DC_ ();
@@ -75,6 +77,14 @@ HDC GetDC(HWND hWnd) {
     return new __DC_(hWnd);
 }
 
+/* A DC drawing into an image in memory rather than the current view, for
+   images of the panel made with no window; released as any other. */
+HDC GetOffscreenDC_(OffscreenRaster * raster) {
+    HDC hDC = new __DC_;
+    hDC->raster = raster;
+    return hDC;
+}
+
 __DC_::__DC_ () {
     curBrush = NULL;
     curPen = NULL;
@@ -159,6 +169,13 @@ void LineTo(HDC hDC, int x, int y){
 
 void __DC_::LineTo(int x, int y) {
     assert(havePen);
+    if (raster) {
+        raster->Line(movedX, movedY, x, y, penWidth, penColor);
+        movedX = x;
+        movedY = y;
+        originKnown = TRUE;
+        return;
+    }
     NSBezierPath * bezier = [NSBezierPath bezierPath];
     
     [bezier setLineWidth:penWidth];
@@ -194,6 +211,10 @@ void MoveToEx(HDC hDC, int x, int y, void* cpp) {
 void Ellipse(__DC_* hDC,  int left,  int top,  int right, int bottom) {
     assert(hDC != NULL);
     assert(hDC->haveBrush);
+    if (hDC->raster) {
+        hDC->raster->FillEllipse(left, top, right, bottom, hDC->brushColor);
+        return;
+    }
     NSRect rect;
     rect.origin.x = left;
     rect.origin.y = top;
@@ -206,7 +227,7 @@ void Ellipse(__DC_* hDC,  int left,  int top,  int right, int bottom) {
     [thePath fill];
 }
 
-void FillRect(HDC, RECT* rp, HBRUSH hBrush) {
+void FillRect(HDC hDC, RECT* rp, HBRUSH hBrush) {
     bool isPen;
     COLORREF cr;
     int param1;
@@ -218,6 +239,10 @@ void FillRect(HDC, RECT* rp, HBRUSH hBrush) {
         assert (!"GDI wrapper retrieval fails in FillRect");
     }
     assert(!isPen);
+    if (hDC != NULL && hDC->raster) {
+        hDC->raster->FillRect(rp->left, rp->top, rp->right, rp->bottom, cr);
+        return;
+    }
     NSBezierPath* thePath = [NSBezierPath bezierPath];
     [thePath appendBezierPathWithRect:RectToMac(rp)];
     [colorFromCOLORREF(cr) set];
@@ -227,6 +252,10 @@ void FillRect(HDC, RECT* rp, HBRUSH hBrush) {
 void Rectangle(HDC hDC, int left, int top, int right, int bottom){
     assert(hDC != NULL);
     assert(hDC->haveBrush);
+    if (hDC->raster) {
+        hDC->raster->FillRect(left, top, right, bottom, hDC->brushColor);
+        return;
+    }
     NSRect rect;
     rect.origin.x = left;
     rect.origin.y = top;
@@ -252,6 +281,29 @@ HDC ReleaseDC(HWND hWnd, HDC hDC) {
     return ReleaseDC_(hWnd, hDC);
 }
 
+/* The same placement as below, in the raster's own font. */
+static int RasterDrawText(__DC_* hDC, const char * s, double fh, RECT* pr, int flags) {
+    int width, height;
+    OffscreenRaster::TextExtent(s, (int)fh, width, height);
+    if (flags & DT_CALCRECT) {
+        pr->top = 0;
+        pr->left = 0;
+        pr->right = width;
+        pr->bottom = height;
+        return pr->bottom;
+    }
+    int x = pr->left;
+    int y = pr->top;
+    if (flags & DT_VCENTER)
+        y += (pr->bottom - pr->top)/2 - height/2;
+    if (flags & DT_CENTER)
+        x += (pr->right - pr->left)/2 - width/2;
+    if (hDC->bkMode != TRANSPARENT)
+        hDC->raster->FillRect(x, y, x + width, y + height, hDC->bkColor);
+    hDC->raster->Text(x, y, s, (int)fh, hDC->textColor);
+    return 0;
+}
+
 int DrawText(__DC_* hDC, char const*s, unsigned long limit, RECT* pr, int flags) {
     std::string tempbuf;
     size_t ll = strlen(s);  /* not really safe */
@@ -277,6 +329,8 @@ int DrawText(__DC_* hDC, char const*s, unsigned long limit, RECT* pr, int flags)
     if (fh < MIN_FONT_SIZE) {
         fh = MIN_FONT_SIZE;
     }
+    if (hDC->raster)
+        return RasterDrawText(hDC, s, fh, pr, flags);
     
     NSString * nfname = [[NSString alloc] initWithUTF8String:fname];
     NSColor * fgColor = colorFromCOLORREF(hDC->textColor);
@@ -335,6 +389,17 @@ void NXM_Polygon(HDC hDC, POINT* points, int n) {
 }
 
 void __DC_::PolygonInt(POINT *points, int xn) {
+    if (raster) {
+        std::vector<OffscreenRaster::Point> rpoints;
+        for (int i = 0; i < xn; i++)
+            rpoints.push_back({(int)points[i].x, (int)points[i].y});
+        raster->FillPolygon(rpoints.data(), xn, brushColor);
+        if (curPen != NULL && curPen != GetStockObject(NULL_PEN))
+            for (int i = 0; i < xn; i++)
+                raster->Line(rpoints[i].x, rpoints[i].y,
+                             rpoints[(i + 1) % xn].x, rpoints[(i + 1) % xn].y, penWidth, penColor);
+        return;
+    }
 
     NSBezierPath *bezier = [NSBezierPath bezierPath];
     [bezier moveToPoint:NSMakePoint(points[0].x, points[0].y)];
@@ -120,9 +120,16 @@ void ShowStateRelaysForObject(int object_number, const char * descrip) {
     }
 }
 
-/* Called from relay eval loop guts on each pass */
+/* Called from relay eval loop guts on each pass: only where relays drawn
+   have changed state -- nxldwin does exactly this. */
 void CheckRelayDisplay () {
-    InvalidateRelayDrafter();  // -- nxldwin does exactly this.
+    HWND rd = getRelayDrafterHWND(false);
+    if (rd == NULL)
+        return;
+    std::vector<RECT> rects;
+    ChangedRelayDrawingRects(rects);
+    for (RECT& r : rects)
+        InvalidateRect(rd, &r, 0);
 }
 
 /* Called by unimplemented commands */
@@ -9,6 +9,7 @@
 #import "MainView.h"
 #import "WinViewUtils.h"
 #include "WinMacCalls.h"
+#include <vector>
 
 #define WM_USER 2000
 #define WM_NXGO_LBUTTONSHIFT (WM_USER+1)
@@ -114,18 +115,26 @@ bool REDISPLAYING = false;
     HDC hDC = GetDC_ ();
     SetTextColor(hDC, 0xFFFFFF);
     SetBkMode(hDC, TRANSPARENT);
-    RECT winRect;
-    winRect.top = (int)dirtyRect.origin.y;
-    winRect.left = (int)dirtyRect.origin.x;
-    winRect.right = (int)(dirtyRect.origin.x + dirtyRect.size.width);
-    winRect.bottom = (int)(dirtyRect.origin.y + dirtyRect.size.height);
-    
-    DisplayVisibleObjectsRect(hDC, winRect);
+    /* Separately invalidated rectangles (see EndInvalidationBatch), rather
+       than the dirtyRect that bounds them all. */
+    const NSRect * drawn;
+    NSInteger ndrawn;
+    [self getRectsBeingDrawn:&drawn count:&ndrawn];
+    std::vector<RECT> winRects;
+    for (NSInteger i = 0; i < ndrawn; i++) {
+        RECT winRect;
+        winRect.top = (int)drawn[i].origin.y;
+        winRect.left = (int)drawn[i].origin.x;
+        winRect.right = (int)(drawn[i].origin.x + drawn[i].size.width);
+        winRect.bottom = (int)(drawn[i].origin.y + drawn[i].size.height);
+        winRects.push_back(winRect);
+    }
+    DisplayVisibleObjectsRects(hDC, winRects.data(), (int)winRects.size());
     
     ReleaseDC_(NULL, hDC);
     REDISPLAYING = false;
 #ifndef TLEDIT
-    InvalidateRelayDrafter();
+    CheckRelayDisplay();
 #endif
 }
 @end
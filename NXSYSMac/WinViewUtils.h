@@ -17,6 +17,7 @@ HDC GetDC_();
 void ReleaseDC_(void*, HDC);
 struct RECT {int left; int right; int top; int bottom;};
 void DisplayVisibleObjectsRect(struct __DC_ *, struct RECT&);
+void DisplayVisibleObjectsRects(struct __DC_ *, const struct RECT *, int);
 void GDISetMainWindow(NSWindow* window, NSView* view);
 void NXGO_Rodentate(unsigned, unsigned, unsigned);
 void NXGOMouseUp();
@@ -24,6 +25,7 @@ void SetTextColor(__DC_*, int);
 void SetBkMode(__DC_*, int);
 void InvalidateRect(void*, RECT*, int);
 void InvalidateRelayDrafter();
+void CheckRelayDisplay();
 void SelectObject(__DC_*, void*);
 void* GetStockObject(void*);
 void LineTo(HDC, int, int);
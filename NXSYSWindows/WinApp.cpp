@@ -326,6 +326,24 @@ void NXSYS_Command(unsigned int cmd) {
 }
 
 #endif
+/* The rectangles of the update region, which BeginPaint gives only as one
+   that bounds them all; to be got before it validates them. */
+static std::vector<RECT> GetUpdateRects (HWND window) {
+	std::vector<RECT> rects;
+	HRGN rgn = CreateRectRgn(0, 0, 0, 0);
+	if (GetUpdateRgn(window, rgn, FALSE) == COMPLEXREGION) {
+		DWORD size = GetRegionData(rgn, 0, NULL);
+		std::vector<char> buf(size);
+		RGNDATA* data = (RGNDATA*)buf.data();
+		if (size && GetRegionData(rgn, size, data)) {
+			RECT* r = (RECT*)data->Buffer;
+			rects.assign(r, r + data->rdh.nCount);
+		}
+	}
+	DeleteObject(rgn);
+	return rects;
+}
+
 WNDPROC_DCL MainWindow_WndProc
 (HWND window, unsigned message, WPARAM wParam, LPARAM lParam)
 {
@@ -341,12 +359,16 @@ WNDPROC_DCL MainWindow_WndProc
 
 	case WM_PAINT:
 	{
+		std::vector<RECT> rects = GetUpdateRects(window);
 		PAINTSTRUCT ps;
 		HDC dc = BeginPaint(window, &ps);
 		SelectObject(dc, Fnt);
 		SetBkColor(dc, RGB(0, 0, 0));
 		SetTextColor(dc, RGB(255, 255, 255));
-		DisplayVisibleObjectsRect(dc, ps.rcPaint);
+		if (rects.empty())
+			DisplayVisibleObjectsRect(dc, ps.rcPaint);
+		else
+			DisplayVisibleObjectsRects(dc, rects.data(), (int)rects.size());
 		EndPaint(window, &ps);
 		break;
 	}
@@ -157,9 +157,13 @@ void RelayShowString (const char *rnm) {
     ShowWindow (S_RelayGraphicsWindow, SW_SHOWNORMAL);
 }
 
+/* Only where relays drawn have changed state. */
 void CheckRelayDisplay() {
     if (S_RelayGraphicsWindow != NULL) {
-	InvalidateRect (S_RelayGraphicsWindow, NULL, 0);
+	std::vector<RECT> rects;
+	ChangedRelayDrawingRects (rects);
+	for (RECT& r : rects)
+	    InvalidateRect (S_RelayGraphicsWindow, &r, 0);
     }
 }
 
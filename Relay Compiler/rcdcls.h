@@ -41,9 +41,10 @@ struct RelayDef {
 };
 
 struct LabelEntry {
-    LabelEntry(Sexpr s_, Sexpr sv_) : s(s_), Svalue(sv_) {}
+    LabelEntry(Sexpr s_, Sexpr sv_, Rlysym* d_) : s(s_), Svalue(sv_), definer(d_) {}
     Sexpr s;
     Sexpr Svalue;
+    Rlysym* definer;  /* for duplicate diagnostics */
 };
 void RC_error (int fatal, const char* s, ...);
 
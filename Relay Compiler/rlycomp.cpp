@@ -26,6 +26,7 @@
 #endif
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <filesystem>
 #include <limits>
 #include <unordered_map>
@@ -88,16 +89,15 @@ static PCTR Pctr = 0;
 static int GensymCtr = 0;
 static PCTR Lowest_Fix8_Unresolved;
 
-static int dep_sorter (const DepPair& A, const DepPair& B) {
-    if (A.affector < B.affector)
-	return -1;
-    if (A.affector > B.affector)
-	return 1;
-    if (A.affected < B.affected)
-	return -1;
-    if (A.affected > B.affected)
-	return 1;
-    return 0;
+/* std::sort wants "less than", not a -1/0/1 qsort comparator. */
+static bool dep_sorter (const DepPair& A, const DepPair& B) {
+    if (A.affector != B.affector)
+	return A.affector < B.affector;
+    return A.affected < B.affected;
+}
+
+static bool dep_equal (const DepPair& A, const DepPair& B) {
+    return A.affector == B.affector && A.affected == B.affected;
 }
 
 
@@ -113,6 +113,7 @@ std::vector<Timer> Timers ;//(50, 1.5f);
 std::vector<DepPair> DependentPairTable;// (2000, 1.5f);
 std::vector<struct Fixup> FixupTable;// (100, 1.5f);
 std::vector<LabelEntry> LabelTable;
+std::unordered_map<const char*, size_t> LabelIndex;  // atom strings are EQ
 
 
 
@@ -275,20 +276,14 @@ struct _Ctxt {
 
 typedef struct _Ctxt Ctxt;
 
-static int dep_list_sorter( const DepPair&A, const DepPair& B) {
+static bool dep_list_sorter( const DepPair&A, const DepPair& B) {
     Rlysym *ar = RelayRefTable[A.affector];
     Rlysym *br = RelayRefTable[B.affector];
-    if (ar->n < br->n)
-	return -1;
-    if (ar->n > br->n)
-	return 1;
+    if (ar->n != br->n)
+	return ar->n < br->n;
     if (ar->type != br->type)
-	return strcmp (redeemRlsymId (ar->type), redeemRlsymId (br->type));
-    if (A.affected < B.affected)
-	return -1;
-    if (A.affected > B.affected)
-	return 1;
-    return 0;
+	return strcmp (redeemRlsymId (ar->type), redeemRlsymId (br->type)) < 0;
+    return A.affected < B.affected;
 }
 
 RLID RelayId (Sexpr s) {
@@ -713,11 +708,16 @@ dot:	    if (disp_ok (Pctr, tag.tramp_pc)) {
     TrampJump (op, tag, 1);
 }
 
+static RLID DefiningRelay;
+
 void AddLabel (Sexpr s, Sexpr v) {
-    for (auto& lp : LabelTable)
-	if (lp.s == s)
-	    RC_error (1, "Duplicate label: %s", s.u.a);
-    LabelTable.emplace_back(s, v);
+    Rlysym* definer = RelayDefTable[DefiningRelay].sym;
+    auto it = LabelIndex.find(s.u.s);
+    if (it != LabelIndex.end())
+	RC_error (1, "Duplicate label: %s, first defined in relay %s, again in relay %s", s.u.a,
+		  LabelTable[it->second].definer->PRep().c_str(), definer->PRep().c_str());
+    LabelIndex[s.u.s] = LabelTable.size();
+    LabelTable.emplace_back(s, v, definer);
 }
 
 void RecordTimer (RLID id, int time) {
@@ -728,17 +728,20 @@ void RecordTimer (RLID id, int time) {
 
 void CompileExpr (Sexpr s, Ctxt* ctxt);
 
-static RLID DefiningRelay;
-
 void RecordDependent (RLID affector) {
-
-    /* Elim duplicates - will speed up runtime and simplify obj seg writer. */
-    for (auto& dp : DependentPairTable)
-	if (dp.affector == affector)
-	    return;
+    /* Duplicates are eliminated in one sort at the end (SortDependentPairs),
+       not by searching the table on every reference. */
     DependentPairTable.emplace_back(affector, DefiningRelay);
 }
 
+/* Sort by affector and eliminate duplicates - will speed up runtime and simplify
+   obj seg writer, which emits each affector's dependents as one contiguous run. */
+static void SortDependentPairs () {
+    std::sort(DependentPairTable.begin(), DependentPairTable.end(), dep_sorter);
+    DependentPairTable.erase(std::unique(DependentPairTable.begin(), DependentPairTable.end(), dep_equal),
+                             DependentPairTable.end());
+}
+
 
 void CompileRlysym (Sexpr s, Ctxt * ctxt, int backf) {
     if (s.type != Lisp::RLYSYM)
@@ -869,16 +872,16 @@ void CompileExpr (Sexpr s, Ctxt* ctxt) {
 						
     }			
     else if (s.type == Lisp::ATOM) {
-        for (auto& lte : LabelTable)
-	    if (lte.s == s) {
-		if (CheckOpt && ctxt->op != CT_VAL)
-		    RC_error (0, "Label Not for val at use time: %s",
+        auto it = LabelIndex.find(s.u.s);
+	if (it != LabelIndex.end()) {
+	    if (CheckOpt && ctxt->op != CT_VAL)
+		RC_error (0, "Label Not for val at use time: %s",
 			  s.u.s);
-		LExpandLevel ++;
-		CompileAndOr (lte.Svalue, CT_AND, ctxt);
-		LExpandLevel --;
-		return ;
-	    }
+	    LExpandLevel ++;
+	    CompileAndOr (LabelTable[it->second].Svalue, CT_AND, ctxt);
+	    LExpandLevel --;
+	    return ;
+	}
 	if (s == T_ATOM) goto tat;
 	else if (s == NIL) goto nat;
 	RC_error (1, "Label/Symbol not known as form: %s", s.u.a);
@@ -1343,6 +1346,7 @@ usage:
     list ("%s\tideal\n%s\tsegment\tcode\n", Ltabs, Ltabs);
 
     CompileLayout (f, fpath);
+    SortDependentPairs();
 
     if (ListOpt) {
         std::sort(DependentPairTable.begin(), DependentPairTable.end(), dep_list_sorter);
@@ -0,0 +1,268 @@
+//
+//  RelayGraph.cpp
+//  RelayIndex
+//
+//  The cross-reference is flattened into compressed adjacency arrays (one
+//  contiguous edge array per direction, indexed by a start offset per relay),
+//  so that every analysis here is a linear-time walk.  Stick loops are Tarjan
+//  strongly-connected components; cone sizes and depth are computed once over
+//  the component DAG, which Tarjan produces in reverse topological order.
+//
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+
+#include "lisp.h"
+#include "RelayGraph.hpp"
+
+namespace RelayGraph {
+
+static std::vector<RLID> Nodes;
+static std::unordered_map<RLID, int> NodeIndex;
+static std::vector<int> DownStart, DownEdges;  // relay -> relays it affects
+static std::vector<int> UpStart, UpEdges;      // relay -> relays it depends on
+
+static std::vector<int> Comp;                  // node -> component number
+static std::vector<std::vector<int>> Comps;    // in Tarjan (sinks-first) order
+static std::vector<int> Depth;                 // per component
+static std::vector<int> DownConeSize, UpConeSize;  // per node
+
+static void BuildCSR(const std::vector<std::pair<int,int>>& edges,
+                     std::vector<int>& start, std::vector<int>& targets) {
+    size_t n = Nodes.size();
+    start.assign(n + 1, 0);
+    for (auto& e : edges)
+        start[e.first + 1]++;
+    for (size_t i = 0; i < n; i++)
+        start[i + 1] += start[i];
+    targets.resize(edges.size());
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (auto& e : edges)
+        targets[fill[e.first]++] = e.second;
+    for (size_t i = 0; i < n; i++)
+        std::sort(targets.begin() + start[i], targets.begin() + start[i + 1]);
+}
+
+/* Iterative Tarjan; relay circuits nest deep enough that recursion is unwise. */
+static void ComputeComponents() {
+    int n = (int)Nodes.size();
+    std::vector<int> index(n, -1), low(n, 0), stack, edge_pos(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<int> call;
+    int counter = 0;
+    Comp.assign(n, -1);
+    Comps.clear();
+
+    for (int root = 0; root < n; root++) {
+        if (index[root] >= 0)
+            continue;
+        call.push_back(root);
+        while (!call.empty()) {
+            int v = call.back();
+            if (index[v] < 0) {
+                index[v] = low[v] = counter++;
+                edge_pos[v] = DownStart[v];
+                stack.push_back(v);
+                on_stack[v] = true;
+            }
+            if (edge_pos[v] < DownStart[v + 1]) {
+                int w = DownEdges[edge_pos[v]++];
+                if (index[w] < 0)
+                    call.push_back(w);
+                else if (on_stack[w])
+                    low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            call.pop_back();
+            if (!call.empty())
+                low[call.back()] = std::min(low[call.back()], low[v]);
+            if (low[v] == index[v]) {
+                std::vector<int> members;
+                int w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = false;
+                    Comp[w] = (int)Comps.size();
+                    members.push_back(w);
+                } while (w != v);
+                std::sort(members.begin(), members.end());
+                Comps.push_back(std::move(members));
+            }
+        }
+    }
+}
+
+/* Reachable-set sizes by bitset union over the component DAG.  Components are
+   visited so that every successor is finished first. */
+static void ComputeCones(bool downstream, std::vector<int>& cone_size) {
+    const std::vector<int>& start = downstream ? DownStart : UpStart;
+    const std::vector<int>& targets = downstream ? DownEdges : UpEdges;
+    size_t ncomps = Comps.size();
+    size_t words = (Nodes.size() + 63) / 64;
+    std::vector<uint64_t> reach(ncomps * words, 0);
+
+    for (size_t k = 0; k < ncomps; k++) {
+        size_t c = downstream ? k : ncomps - 1 - k;
+        uint64_t* R = &reach[c * words];
+        for (int v : Comps[c]) {
+            R[v / 64] |= uint64_t(1) << (v % 64);
+            for (int e = start[v]; e < start[v + 1]; e++) {
+                size_t d = Comp[targets[e]];
+                if (d == c)
+                    continue;
+                const uint64_t* D = &reach[d * words];
+                for (size_t i = 0; i < words; i++)
+                    R[i] |= D[i];
+            }
+        }
+    }
+    cone_size.assign(Nodes.size(), 0);
+    for (size_t c = 0; c < ncomps; c++) {
+        int count = 0;
+        for (size_t i = 0; i < words; i++)
+            for (uint64_t w = reach[c * words + i]; w; w &= w - 1)
+                count++;
+        for (int v : Comps[c])
+            cone_size[v] = count - 1;
+    }
+}
+
+static void ComputeDepth() {
+    Depth.assign(Comps.size(), 1);
+    for (size_t c = 0; c < Comps.size(); c++)
+        for (int v : Comps[c])
+            for (int e = DownStart[v]; e < DownStart[v + 1]; e++) {
+                size_t d = Comp[DownEdges[e]];
+                if (d != c)
+                    Depth[c] = std::max(Depth[c], Depth[d] + 1);
+            }
+}
+
+void Build(const std::vector<RLID>& nodes, const RefMap& backrefs) {
+    Clear();
+    Nodes = nodes;
+    for (size_t i = 0; i < Nodes.size(); i++)
+        NodeIndex[Nodes[i]] = (int)i;
+    std::vector<std::pair<int,int>> down, up;
+    for (auto& br : backrefs) {
+        auto from = NodeIndex.find(br.first);
+        if (from == NodeIndex.end())
+            continue;
+        for (RLID ref : br.second) {
+            auto to = NodeIndex.find(ref);
+            if (to == NodeIndex.end())
+                continue;
+            down.emplace_back(from->second, to->second);
+            up.emplace_back(to->second, from->second);
+        }
+    }
+    BuildCSR(down, DownStart, DownEdges);
+    BuildCSR(up, UpStart, UpEdges);
+    ComputeComponents();
+    ComputeDepth();
+    ComputeCones(true, DownConeSize);
+    ComputeCones(false, UpConeSize);
+}
+
+void Clear() {
+    Nodes.clear();
+    NodeIndex.clear();
+    DownStart.clear(); DownEdges.clear();
+    UpStart.clear(); UpEdges.clear();
+    Comp.clear();
+    Comps.clear();
+    Depth.clear();
+    DownConeSize.clear();
+    UpConeSize.clear();
+}
+
+std::vector<RLID> Cone(RLID r, bool downstream) {
+    std::vector<RLID> result;
+    auto it = NodeIndex.find(r);
+    if (it == NodeIndex.end())
+        return result;
+    const std::vector<int>& start = downstream ? DownStart : UpStart;
+    const std::vector<int>& targets = downstream ? DownEdges : UpEdges;
+    std::vector<bool> seen(Nodes.size(), false);
+    std::vector<int> queue {it->second};
+    seen[it->second] = true;
+    for (size_t q = 0; q < queue.size(); q++) {
+        int v = queue[q];
+        for (int e = start[v]; e < start[v + 1]; e++)
+            if (!seen[targets[e]]) {
+                seen[targets[e]] = true;
+                queue.push_back(targets[e]);
+            }
+    }
+    for (size_t i = 0; i < Nodes.size(); i++)  // nodes are in listing order
+        if (seen[i] && (int)i != it->second)
+            result.push_back(Nodes[i]);
+    return result;
+}
+
+static std::string JSONString(const std::string& s) {
+    std::string result = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+bool WriteJSON(const char* pathname, const std::string& source) {
+    std::ofstream out(pathname);
+    if (!out.is_open())
+        return false;
+
+    int max_depth = 0;
+    for (int d : Depth)
+        max_depth = std::max(max_depth, d);
+
+    out << "{\n  \"source\": " << JSONString(source) << ",\n";
+    out << "  \"relays\": " << Nodes.size() << ",\n";
+    out << "  \"references\": " << DownEdges.size() << ",\n";
+    out << "  \"max_depth\": " << max_depth << ",\n";
+
+    out << "  \"stick_loops\": [";
+    bool first = true;
+    for (auto& members : Comps) {
+        if (members.size() < 2)
+            continue;
+        out << (first ? "\n    [" : ",\n    [");
+        first = false;
+        for (size_t i = 0; i < members.size(); i++)
+            out << (i ? ", " : "") << JSONString(Nodes[members[i]]->PRep());
+        out << "]";
+    }
+    out << (first ? "],\n" : "\n  ],\n");
+
+    std::vector<int> ranked(Nodes.size());
+    for (size_t i = 0; i < ranked.size(); i++)
+        ranked[i] = (int)i;
+    std::stable_sort(ranked.begin(), ranked.end(), [](int a, int b) {
+        return DownConeSize[a] > DownConeSize[b];
+    });
+
+    out << "  \"ranking\": [";
+    for (size_t i = 0; i < ranked.size(); i++) {
+        int v = ranked[i];
+        out << (i ? ",\n    " : "\n    ");
+        out << "{\"relay\": " << JSONString(Nodes[v]->PRep())
+            << ", \"fanin\": " << UpStart[v + 1] - UpStart[v]
+            << ", \"fanout\": " << DownStart[v + 1] - DownStart[v]
+            << ", \"fanin_cone\": " << UpConeSize[v]
+            << ", \"fanout_cone\": " << DownConeSize[v]
+            << ", \"depth\": " << Depth[Comp[v]] << "}";
+    }
+    out << (ranked.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+    return true;
+}
+
+} // end namespace RelayGraph
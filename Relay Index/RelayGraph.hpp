@@ -0,0 +1,35 @@
+//
+//  RelayGraph.hpp
+//  RelayIndex
+//
+//  Dependency-graph analysis of the relay cross-reference: transitive cones,
+//  stick loops (strongly-connected components), and propagation depth.
+//
+
+#ifndef RelayGraph_hpp
+#define RelayGraph_hpp
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+struct Rlysym;
+
+namespace RelayGraph {
+
+typedef Rlysym* RLID;
+typedef std::unordered_map<RLID, std::unordered_set<RLID>> RefMap;
+
+/* Nodes must be supplied in the order results are to be listed in; backrefs maps
+   each relay to the relays that have its contacts in their circuits, i.e., the
+   direction in which a state change propagates. */
+void Build(const std::vector<RLID>& nodes, const RefMap& backrefs);
+void Clear();
+
+std::vector<RLID> Cone(RLID r, bool downstream);   // excluding r itself
+bool WriteJSON(const char* pathname, const std::string& source);
+
+};
+
+#endif /* RelayGraph_hpp */
@@ -21,12 +21,16 @@
 #include <sstream>
 #include <filesystem>
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
 
 #include "STLExtensions.h"
 #include "argparse.hpp"
 
 #include "lisp.h"
 #include "SourceLoc.hpp"
+#include "RelayGraph.hpp"
 
 #define RELAYS_PER_LINE 8
 #define RELAY_WIDTH 10
@@ -41,20 +45,45 @@ using std::stringstream;
 
 namespace fs = std::filesystem;
 
-std::unordered_map<RLID, std::vector<RLID>> BackRefMap;
+std::unordered_map<RLID, std::unordered_set<RLID>> BackRefMap;
+std::unordered_map<RLID, std::unordered_set<RLID>> ForwardRefMap;  // for queries
+std::unordered_map<const char *, std::unordered_set<RLID>> LabelUsers;
 std::unordered_map<const char *, Sexpr>LabelMap; //atom strings guaranteed EQ
 std::unordered_set<RLID> RelaysReferenced;
 std::unordered_set<RLID> RelaysDefined;
 
 static int ReferencesRecorded = 0;
 
+/* Every source file read, in order, with a digest of its content.  These are
+   recorded in the .xref header, so a rerun over unchanged sources can see that
+   and leave the .xref and TAGS alone rather than reparse the whole interlocking. */
+struct SourceFile {
+    string path;
+    uint64_t digest;
+    fs::file_time_type mtime;  // query mode watches this
+};
+static std::vector<SourceFile> SourceDigests;
+static const char SOURCE_DIGEST_TAG[] = "; source ";
+
+/* In query mode a fatal error in the sources (perhaps only half-saved) must
+   not end the process an editor is talking to; it is thrown to QueryLoop. */
+struct CompileError {
+    string message;
+};
+static bool Querying = false;
+
 void RC_error (int fatal, const char* s, ...) {
+    char buf[1024];
     va_list ap;
     va_start (ap, s);
-    vfprintf (stderr, s, ap);
-    fprintf(stderr, "\n");
-    if (fatal)
+    vsnprintf (buf, sizeof(buf), s, ap);
+    va_end (ap);
+    fprintf(stderr, "%s\n", buf);
+    if (fatal) {
+        if (Querying)
+            throw CompileError{buf};
         exit(3);
+    }
 }
 
 bool rsym_sorter (const RLID a, const RLID b) {
@@ -78,6 +107,12 @@ std::vector<RLID> OrderUOSet(const std::unordered_set<RLID>& S) {
     return V;  // C++11 "move" semantics!!
 }
 
+std::vector<RLID> AllRelaysOrdered() {
+    std::unordered_set<RLID> all(RelaysDefined);
+    all.insert(RelaysReferenced.begin(), RelaysReferenced.end());
+    return OrderUOSet(all);
+}
+
 DEFLSYM(AND);
 DEFLSYM(OR);
 DEFLSYM(NOT);
@@ -97,11 +132,10 @@ void CompileReference (Sexpr s, RLID being_defined) {
     if (s.type != Lisp::RLYSYM)
         RC_error (3, "Non-Rlysym handed to CompileReference.");
     RLID being_referenced = s.u.r;
-    std::vector<RLID>& V = BackRefMap[being_referenced];
     if (being_referenced != being_defined &&
-        std::find(V.begin(), V.end(), being_defined) == V.end()) {
+        BackRefMap[being_referenced].insert(being_defined).second) {
 
-        V.push_back(being_defined);
+        ForwardRefMap[being_defined].insert(being_referenced);
         RelaysReferenced.insert(being_referenced);
         ReferencesRecorded++;
     }
@@ -151,6 +185,7 @@ void CompileExpr (Sexpr s, RLID being_defined) {
         if (s == T_ATOM || s == NIL) {
         }
         else if (LabelMap.count(s.u.s)) {
+            LabelUsers[s.u.s].insert(being_defined);
             CompileList (LabelMap[s.u.s], being_defined);
         }
         else
@@ -191,10 +226,68 @@ void close_report(fs::path path, std::ofstream& ofs) {
 void CleanUpRelaySys () {
     for (auto& lte : LabelMap)
         dealloc_ncyclic_sexp (lte.second);
+    LabelMap.clear();
+    LabelUsers.clear();
+    BackRefMap.clear();
+    ForwardRefMap.clear();
+    RelaysReferenced.clear();
+    RelaysDefined.clear();
+    ReferencesRecorded = 0;
+    SourceDigests.clear();
+    SourceLoc::Clear();
+    RelayGraph::Clear();
+    MacroCleanup();
 }
 
 void CompileFile(FILE* f, fs::path path);  // for recursive call for INCLUDE
 
+/* FNV-1a, 64 bit. Not cryptographic; it only has to notice edits. */
+static bool DigestFile (const fs::path& path, uint64_t& digest) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open())
+        return false;
+    digest = 0xcbf29ce484222325ULL;
+    char buf[8192];
+    while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) {
+        for (std::streamsize i = 0; i < ifs.gcount(); i++) {
+            digest ^= (unsigned char)buf[i];
+            digest *= 0x100000001b3ULL;
+        }
+    }
+    return true;
+}
+
+/* True if outpath and tagspath exist, and every source file recorded in
+   outpath's header still has the digest recorded there. */
+static bool IndexUpToDate (const fs::path& outpath, const fs::path& tagspath) {
+    if (!fs::exists(tagspath))
+        return false;
+    std::ifstream ifs(outpath);
+    if (!ifs.is_open())
+        return false;
+    const size_t taglen = sizeof(SOURCE_DIGEST_TAG) - 1;
+    int sources_checked = 0;
+    string line;
+    while (std::getline(ifs, line) && line.size() > 0 && line[0] == ';') {
+        if (line.compare(0, taglen, SOURCE_DIGEST_TAG) != 0)
+            continue;
+        size_t space = line.find(' ', taglen);
+        if (space == string::npos)
+            return false;
+        string hex = line.substr(taglen, space - taglen);
+        char * end = nullptr;
+        errno = 0;
+        uint64_t recorded = strtoull(hex.c_str(), &end, 16);
+        if (hex.empty() || *end != '\0' || errno == ERANGE)
+            return false;       // hand-edited or cut off: rebuild
+        uint64_t current;
+        if (!DigestFile(line.substr(space + 1), current) || current != recorded)
+            return false;
+        sources_checked++;
+    }
+    return sources_checked > 0;
+}
+
 void CompileTopLevelForm (Sexpr s, fs::path path, long filepos) {
     if (s.type != Lisp::tCONS)
         RC_error (1, "Item definition not a list?");
@@ -244,15 +337,25 @@ void CompileTopLevelForm (Sexpr s, fs::path path, long filepos) {
 }
 
 void CompileFile (FILE* f, fs::path path) {
-    for (;;) {
-        SourceLoc::RecordFile(path.string().c_str());
-        skip_lisp_file_whitespace(f);
-        long sexp_pos = ftell(f);
-        Sexpr s = read_sexp (f);
-        if (s == EOFOBJ)
-            break;
-        CompileTopLevelForm (s, path, sexp_pos);
-        dealloc_ncyclic_sexp (s);
+    uint64_t digest = 0;
+    DigestFile(path, digest);
+    std::error_code ec;
+    SourceDigests.push_back({path.string(), digest, fs::last_write_time(path, ec)});
+    try {
+        for (;;) {
+            SourceLoc::RecordFile(path.string().c_str());
+            skip_lisp_file_whitespace(f);
+            long sexp_pos = ftell(f);
+            Sexpr s = read_sexp (f);
+            if (s == EOFOBJ)
+                break;
+            CompileTopLevelForm (s, path, sexp_pos);
+            dealloc_ncyclic_sexp (s);
+        }
+    }
+    catch (CompileError&) {
+        fclose (f);
+        throw;
     }
     SourceLoc::ComputeFileLines(path.string().c_str(), f);
     fclose (f);
@@ -273,17 +376,23 @@ string padit (string s, long n) {
     return s;
 }
 
-void IndexOneRelay(RLID rsym, std::ofstream& outs) {
-    auto& references = BackRefMap[rsym];
-    outs << endl << rsym->PRep() << " ";
+string DefinitionLoc(RLID rsym) {
     SourceLoc::Info SLinfo;
-    bool known = SourceLoc::getSourceLoc(rsym->PRep().c_str(), SLinfo);
-    if (known) {
-        outs << SLinfo.line_number << " " << SLinfo.file_pos << " " << SLinfo.file;
-    } else {
-        outs << "UNDEFINED";
-    }
+    if (!SourceLoc::getSourceLoc(rsym->PRep().c_str(), SLinfo))
+        return "UNDEFINED";
+    return std::to_string(SLinfo.line_number) + " " + std::to_string(SLinfo.file_pos) + " " + SLinfo.file;
+}
+
+std::vector<RLID> OrderedRefs(std::unordered_map<RLID, std::unordered_set<RLID>>& M, RLID rsym) {
+    auto& refset = M[rsym];
+    std::vector<RLID> references(refset.begin(), refset.end());
     std::sort(references.begin(), references.end(), rsym_sorter);
+    return references;
+}
+
+void IndexOneRelay(RLID rsym, std::ofstream& outs) {
+    auto references = OrderedRefs(BackRefMap, rsym);
+    outs << endl << rsym->PRep() << " " << DefinitionLoc(rsym);
 
     int i = 0;
     for (auto ref : references) {
@@ -295,6 +404,114 @@ void IndexOneRelay(RLID rsym, std::ofstream& outs) {
     outs << endl;
 }
 
+/* Query mode.  The index is kept in memory and questions are read one per line
+   from standard input, so an editor can keep RelayIndex running as a subprocess
+   instead of rereading TAGS or spawning a program per lookup.  Each answer is one
+   line; errors start with "?".  Before each query the source files' modification
+   times are checked, and the index rebuilt if any has changed.
+
+      where 155LS      155LS 251 7315 myrtle.trk   (or 155LS UNDEFINED)
+      users 155LS      relays with a contact of 155LS in their circuits
+      uses 155LS       relays with a contact in 155LS's circuit
+      label XYZ        relays whose circuits use LABEL XYZ
+      fanout 155LS     every relay a change of 155LS can propagate to
+      fanin 155LS      every relay whose change can propagate to 155LS
+      quit
+*/
+
+static bool SourcesChanged() {
+    for (auto& sf : SourceDigests) {
+        std::error_code ec;
+        if (fs::last_write_time(sf.path, ec) != sf.mtime)
+            return true;
+    }
+    return false;
+}
+
+static string JoinRelays(const std::vector<RLID>& V) {
+    string result;
+    for (auto r : V) {
+        if (!result.empty())
+            result += ' ';
+        result += r->PRep();
+    }
+    return result;
+}
+
+/* A reload that fails leaves the index stale (what was read of it is not
+   to be trusted), and every query is answered with the error, the sources
+   being reread for each until they compile again. */
+static void QueryLoop(fs::path inpath) {
+    string line;
+    string stale;                       // the compile error, if stale
+    Querying = true;
+    while (std::getline(std::cin, line)) {
+        stringstream ls(line);
+        string verb, arg;
+        ls >> verb >> arg;
+        if (verb.empty())
+            continue;
+        if (verb == "quit")
+            break;
+        if (!stale.empty() || SourcesChanged()) {
+            CleanUpRelaySys();
+            FILE* f = fopen (inpath.string().c_str(), "rb");
+            if (f == NULL) {
+                stale = "Cannot reopen " + inpath.string();
+                cout << "? " << stale << endl;
+                continue;
+            }
+            try {
+                CompileLayout(f, inpath);
+                SourceLoc::Correlate();
+                RelayGraph::Build(AllRelaysOrdered(), BackRefMap);
+                stale.clear();
+            }
+            catch (CompileError& e) {
+                stale = e.message;
+            }
+        }
+        if (!stale.empty()) {
+            cout << "? compile error: " << stale << endl;
+            continue;
+        }
+        if (arg.empty()) {
+            cout << "? Usage: where|users|uses|fanout|fanin|label name" << endl;
+            continue;
+        }
+        if (verb == "label") {
+            Sexpr atom = intern(arg.c_str());
+            auto it = LabelUsers.find(atom.u.s);
+            if (it == LabelUsers.end())
+                cout << "? No such label: " << arg << endl;
+            else {
+                std::vector<RLID> V(it->second.begin(), it->second.end());
+                std::sort(V.begin(), V.end(), rsym_sorter);
+                cout << JoinRelays(V) << endl;
+            }
+            continue;
+        }
+        Sexpr rs = RlysymFromStringNocreate(arg.c_str());
+        if (rs.type != Lisp::RLYSYM) {
+            cout << "? No such relay: " << arg << endl;
+            continue;
+        }
+        RLID rsym = rs.u.r;
+        if (verb == "where")
+            cout << rsym->PRep() << " " << DefinitionLoc(rsym) << endl;
+        else if (verb == "users")
+            cout << JoinRelays(OrderedRefs(BackRefMap, rsym)) << endl;
+        else if (verb == "uses")
+            cout << JoinRelays(OrderedRefs(ForwardRefMap, rsym)) << endl;
+        else if (verb == "fanout")
+            cout << JoinRelays(RelayGraph::Cone(rsym, true)) << endl;
+        else if (verb == "fanin")
+            cout << JoinRelays(RelayGraph::Cone(rsym, false)) << endl;
+        else
+            cout << "? Unknown query: " << verb << endl;
+    }
+}
+
 int main (int argc, const char ** argv) {
     
     string compdesc = FormatString("Relay Indexer of %s %s", __DATE__, __TIME__);
@@ -309,7 +526,10 @@ int main (int argc, const char ** argv) {
     argparse::ArgSet Aset (compdesc,
                           {
         {"source", "help=Source .trk file (main)."},
-        {"-o", "--outpath", "help=Non-default listring path (dft = source.xref}"}});
+        {"-o", "--outpath", "help=Non-default listring path (dft = source.xref}"},
+        {"-f", "--force", "help=Rebuild even if no source has changed.", "boolean="},
+        {"-q", "--query", "help=After indexing, answer queries from standard input.", "boolean="},
+        {"-j", "--json", "help=Also write dependency analysis (source.json).", "boolean="}});
     
     auto args = Aset.Parse(argc, argv);
 
@@ -317,6 +537,14 @@ int main (int argc, const char ** argv) {
     if (!inpath.has_extension())
         inpath.replace_extension(".trk");
 
+    fs::path outpath = args["outpath"] ? args["outpath"] : fs::path(inpath).replace_extension(".xref");
+    fs::path tagspath = fs::path(inpath).replace_filename("TAGS");
+
+    if (!args["force"] && !args["query"] && !args["json"] && IndexUpToDate(outpath, tagspath)) {
+        cout << outpath.string() << " and " << tagspath.string() << " are up to date." << endl;
+        return 0;
+    }
+
     FILE* f = fopen (inpath.string().c_str(), "rb");
     if (f == NULL) {
         cerr << "Cannot open " << inpath << " for reading" <<endl;
@@ -325,14 +553,13 @@ int main (int argc, const char ** argv) {
 
     CompileLayout (f, inpath.c_str()); //calls fclose
     SourceLoc::Correlate();
+    RelayGraph::Build(AllRelaysOrdered(), BackRefMap);
     
     stringstream relay_def_note;
     relay_def_note << RelaysDefined.size() << " relays defined, " << RelaysReferenced.size() << " referenced, " << ReferencesRecorded << " references." << endl;
     cout << relay_def_note.str();
     // will be output to file later
 
-    fs::path outpath = args["outpath"] ? args["outpath"] : fs::path(inpath).replace_extension(".xref");
-    fs::path tagspath = fs::path(inpath).replace_filename("TAGS");
     if (!SourceLoc::WriteTagsFile(tagspath.string().c_str())) {
         cerr << "Can't write " << tagspath << "\n";
         return 3;
@@ -348,11 +575,23 @@ int main (int argc, const char ** argv) {
     struct tm* tblock = localtime (&timer);
     outs << "; RelayXref of " << inpath.string() << " at " << asctime(tblock) << "; by " << compdesc <<endl;
     outs << "; " << relay_def_note.str();
+    for (auto& sd : SourceDigests)
+        outs << SOURCE_DIGEST_TAG << std::hex << sd.digest << std::dec << " " << sd.path << endl;
 
     for (auto rsym : OrderUOSet(RelaysReferenced)) {
         IndexOneRelay(rsym, outs);
     }
     close_report(outpath, outs);
+    if (args["json"]) {
+        fs::path jsonpath = fs::path(outpath).replace_extension(".json");
+        if (!RelayGraph::WriteJSON(jsonpath.string().c_str(), inpath.string())) {
+            cerr << "Can't write " << jsonpath << "\n";
+            return 3;
+        }
+        cout << "Wrote " << jsonpath.string() << ", " << SourceLoc::get_file_size(jsonpath.string().c_str()) << " bytes." << endl;
+    }
+    if (args["query"])
+        QueryLoop(inpath);
     SourceLoc::Clear(); // QA it for NXSYS
     
     return 0;